@@ -0,0 +1,66 @@
+/* ScummVM - Graphic Adventure Engine
+ *
+ * ScummVM is the legal property of its developers, whose names
+ * are too numerous to list here. Please refer to the COPYRIGHT
+ * file distributed with this source distribution.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * $URL$
+ * $Id$
+ *
+ */
+
+#include "deskadv/blit.h"
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+namespace Deskadv {
+
+#ifdef __AVX2__
+
+// Built with -mavx2, only called once the CPU is known to have it. One
+// tile row is one register.
+static void blitTileAVX2(byte *dst, uint pitch, const byte *src, byte key) {
+	const __m256i k = _mm256_set1_epi8((char)key);
+	for (uint y = 0; y < 32; y++, src += 32, dst += pitch) {
+		__m256i s = _mm256_loadu_si256((const __m256i *)src);
+		__m256i m = _mm256_cmpeq_epi8(s, k);
+		uint32 mask = (uint32)_mm256_movemask_epi8(m);
+		if (mask == 0xFFFFFFFF)
+			continue;
+		if (mask == 0) {
+			_mm256_storeu_si256((__m256i *)dst, s);
+			continue;
+		}
+
+		__m256i d = _mm256_loadu_si256((const __m256i *)dst);
+		_mm256_storeu_si256((__m256i *)dst, _mm256_blendv_epi8(s, d, m));
+	}
+}
+
+#endif
+
+TileBlitProc getTileBlitAVX2(void) {
+#ifdef __AVX2__
+	return blitTileAVX2;
+#else
+	return 0;
+#endif
+}
+
+} // End of namespace Deskadv
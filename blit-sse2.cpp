@@ -0,0 +1,68 @@
+/* ScummVM - Graphic Adventure Engine
+ *
+ * ScummVM is the legal property of its developers, whose names
+ * are too numerous to list here. Please refer to the COPYRIGHT
+ * file distributed with this source distribution.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * $URL$
+ * $Id$
+ *
+ */
+
+#include "deskadv/blit.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace Deskadv {
+
+#ifdef __SSE2__
+
+// Built with -msse2, only called once the CPU is known to have it
+static void blitTileSSE2(byte *dst, uint pitch, const byte *src, byte key) {
+	const __m128i k = _mm_set1_epi8((char)key);
+	for (uint y = 0; y < 32; y++, src += 32, dst += pitch) {
+		for (uint x = 0; x < 32; x += 16) {
+			__m128i s = _mm_loadu_si128((const __m128i *)(src + x));
+			__m128i m = _mm_cmpeq_epi8(s, k);
+			int mask = _mm_movemask_epi8(m);
+			if (mask == 0xFFFF)
+				continue;
+			if (mask == 0) {
+				_mm_storeu_si128((__m128i *)(dst + x), s);
+				continue;
+			}
+
+			__m128i d = _mm_loadu_si128((const __m128i *)(dst + x));
+			d = _mm_or_si128(_mm_and_si128(m, d), _mm_andnot_si128(m, s));
+			_mm_storeu_si128((__m128i *)(dst + x), d);
+		}
+	}
+}
+
+#endif
+
+TileBlitProc getTileBlitSSE2(void) {
+#ifdef __SSE2__
+	return blitTileSSE2;
+#else
+	return 0;
+#endif
+}
+
+} // End of namespace Deskadv
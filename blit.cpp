@@ -0,0 +1,133 @@
+/* ScummVM - Graphic Adventure Engine
+ *
+ * ScummVM is the legal property of its developers, whose names
+ * are too numerous to list here. Please refer to the COPYRIGHT
+ * file distributed with this source distribution.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * $URL$
+ * $Id$
+ *
+ */
+
+#include "deskadv/blit.h"
+
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+#define DESKADV_CPUID
+#include <cpuid.h>
+#endif
+
+namespace Deskadv {
+
+static void blitTileReference(byte *dst, uint pitch, const byte *src, byte key) {
+	for (uint y = 0; y < 32; y++, src += 32, dst += pitch) {
+		for (uint x = 0; x < 32; x++) {
+			if (src[x] != key)
+				dst[x] = src[x];
+		}
+	}
+}
+
+static void blitTileScalar(byte *dst, uint pitch, const byte *src, byte key) {
+	for (uint y = 0; y < 32; y++, src += 32, dst += pitch) {
+		const byte *hole = (const byte *)memchr(src, key, 32);
+		if (!hole) {
+			memcpy(dst, src, 32);
+			continue;
+		}
+
+		// Opaque run up to the first key pixel, masked after it
+		uint x = hole - src;
+		memcpy(dst, src, x);
+		for (x++; x < 32; x++) {
+			if (src[x] != key)
+				dst[x] = src[x];
+		}
+	}
+}
+
+#ifdef DESKADV_CPUID
+static bool hasCpuSSE2(void) {
+	unsigned int eax, ebx, ecx, edx;
+	if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+		return false;
+	return (edx & (1 << 26)) != 0;
+}
+
+static bool hasCpuAVX2(void) {
+	unsigned int eax, ebx, ecx, edx;
+	if (__get_cpuid_max(0, 0) < 7 || !__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+		return false;
+	// AVX, and the OS saving the YMM registers (OSXSAVE, XCR0 bits 1 and 2)
+	if ((ecx & ((1 << 27) | (1 << 28))) != ((1 << 27) | (1 << 28)))
+		return false;
+	unsigned int xcr0, xcr0High;
+	__asm__ __volatile__(".byte 0x0f, 0x01, 0xd0" : "=a" (xcr0), "=d" (xcr0High) : "c" (0)); // xgetbv
+	if ((xcr0 & 6) != 6)
+		return false;
+	__cpuid_count(7, 0, eax, ebx, ecx, edx);
+	return (ebx & (1 << 5)) != 0;
+}
+#endif
+
+const char *getTileBlitName(TileBlitKernel kernel) {
+	static const char *const names[kTileBlitKernelCount] = {
+		"reference", "scalar", "sse2", "avx2"
+	};
+	return kernel < kTileBlitKernelCount ? names[kernel] : "unknown";
+}
+
+bool isTileBlitSupported(TileBlitKernel kernel) {
+	switch (kernel) {
+	case kTileBlitReference:
+	case kTileBlitScalar:
+		return true;
+#ifdef DESKADV_CPUID
+	case kTileBlitSSE2:
+		return getTileBlitSSE2() && hasCpuSSE2();
+	case kTileBlitAVX2:
+		return getTileBlitAVX2() && hasCpuAVX2();
+#endif
+	default:
+		return false;
+	}
+}
+
+TileBlitProc getTileBlit(TileBlitKernel kernel) {
+	if (!isTileBlitSupported(kernel))
+		return 0;
+
+	switch (kernel) {
+	case kTileBlitReference:
+		return blitTileReference;
+	case kTileBlitSSE2:
+		return getTileBlitSSE2();
+	case kTileBlitAVX2:
+		return getTileBlitAVX2();
+	default:
+		return blitTileScalar;
+	}
+}
+
+TileBlitKernel getBestTileBlit(void) {
+	if (isTileBlitSupported(kTileBlitAVX2))
+		return kTileBlitAVX2;
+	if (isTileBlitSupported(kTileBlitSSE2))
+		return kTileBlitSSE2;
+	return kTileBlitScalar;
+}
+
+} // End of namespace Deskadv
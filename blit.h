@@ -0,0 +1,61 @@
+/* ScummVM - Graphic Adventure Engine
+ *
+ * ScummVM is the legal property of its developers, whose names
+ * are too numerous to list here. Please refer to the COPYRIGHT
+ * file distributed with this source distribution.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * $URL$
+ * $Id$
+ *
+ */
+
+#ifndef DESKADV_BLIT_H
+#define DESKADV_BLIT_H
+
+#include "common/scummsys.h"
+
+namespace Deskadv {
+
+// Copies a 32x32 tile to dst, leaving the pixels under the key color as
+// they are
+typedef void (*TileBlitProc)(byte *dst, uint pitch, const byte *src, byte key);
+
+enum TileBlitKernel {
+	kTileBlitReference = 0, // One pixel at a time
+	kTileBlitScalar,        // memcpy for opaque rows
+	kTileBlitSSE2,
+	kTileBlitAVX2,
+	kTileBlitKernelCount
+};
+
+const char *getTileBlitName(TileBlitKernel kernel);
+// Whether the kernel is built in and the CPU runs it
+bool isTileBlitSupported(TileBlitKernel kernel);
+// 0 if the kernel is not supported
+TileBlitProc getTileBlit(TileBlitKernel kernel);
+// Fastest supported kernel
+TileBlitKernel getBestTileBlit(void);
+
+// The vector kernels, 0 when the compiler did not build them. module.mk
+// gives their files -msse2 and -mavx2 on x86, they check __SSE2__ and
+// __AVX2__ themselves.
+TileBlitProc getTileBlitSSE2(void);
+TileBlitProc getTileBlitAVX2(void);
+
+} // End of namespace Deskadv
+
+#endif
@@ -25,6 +25,7 @@
 
 #include "deskadv/deskadv.h"
 #include "deskadv/console.h"
+#include "deskadv/palette.h"
 
 namespace Deskadv {
 
@@ -43,6 +44,8 @@ DeskadvConsole::DeskadvConsole(DeskadvEngine *vm) : GUI::Debugger(), _vm(vm) {
 	registerCmd("playSound", WRAP_METHOD(DeskadvConsole, cmdPlaySound));
 	registerCmd("stopSound", WRAP_METHOD(DeskadvConsole, cmdStopSound));
 	registerCmd("drawZone", WRAP_METHOD(DeskadvConsole, cmdDrawZone));
+	registerCmd("hotspots", WRAP_METHOD(DeskadvConsole, cmdHotspots));
+	registerCmd("testBlit", WRAP_METHOD(DeskadvConsole, cmdTestBlit));
 }
 
 DeskadvConsole::~DeskadvConsole() {
@@ -210,20 +213,105 @@ bool DeskadvConsole::cmdDrawZone(int argc, const char **argv) {
 	}
 
 	// TODO: Add Support to scroll Zone.
-	if (num < _vm->_resource->getZoneCount()) {
-		ZONE *z = _vm->_resource->getZone(num);
-		for (uint y = 0; y < 9; y++) {
-			for (uint x = 0; x < 9; x++) {
-				for (uint layer = 0; layer < 3; layer++) {
-					uint16 tileRef = z->tiles[layer][(y*z->width)+x];
-					if (tileRef != 0xFFFF)
-						_vm->_gfx->drawTile(tileRef, x, y);
+	_vm->_gfx->drawZone(_vm->_zoneState, num, 0, 0);
+
+	return false;
+}
+
+bool DeskadvConsole::cmdHotspots(int argc, const char **argv) {
+	if (argc != 2) {
+		debugPrintf("Usage: hotspots <zone num>\n");
+		return true;
+	}
+
+	uint16 num = atoi(argv[1]);
+	if (num >= _vm->_resource->getZoneCount()) {
+		debugPrintf("zone num must be in range 0 to %d\n", _vm->_resource->getZoneCount() - 1);
+		return true;
+	}
+
+	// Cell grid, through the same lookups the game uses
+	const ZONE *z = _vm->_resource->getZone(num);
+	for (uint y = 0; y < z->height; y++) {
+		Common::String row;
+		for (uint x = 0; x < z->width; x++) {
+			uint count = 0;
+			for (const HOTSPOT *h = _vm->_resource->getHotspotAt(z, x, y); h; h = _vm->_resource->getNextHotspotAt(z, h))
+				count++;
+			row += count ? Common::String::format(" %d", count) : " .";
+		}
+		debugPrintf("%s\n", row.c_str());
+	}
+
+	for (uint y = 0; y < z->height; y++) {
+		for (uint x = 0; x < z->width; x++) {
+			for (const HOTSPOT *h = _vm->_resource->getHotspotAt(z, x, y); h; h = _vm->_resource->getNextHotspotAt(z, h))
+				debugPrintf("%d, %d: type %d, enabled %d, argument %d\n", x, y, h->type, h->enabled, h->argument);
+		}
+	}
+	return true;
+}
+
+bool DeskadvConsole::cmdTestBlit(int argc, const char **argv) {
+	if (argc > 2) {
+		debugPrintf("Usage: testBlit [iterations]\n");
+		return true;
+	}
+
+	uint iterations = (argc == 2) ? atoi(argv[1]) : 10000;
+
+	// Odd pitch and offset so no kernel gets aligned rows, with a border
+	// to catch writes outside the tile
+	const uint pitch = 32 + 13;
+	const uint size = pitch * (32 + 2);
+	const uint offset = pitch + 5;
+	byte tile[32 * 32];
+	byte expected[size];
+	byte actual[size];
+	Common::RandomSource rnd("deskadvTestBlit");
+
+	TileBlitProc reference = getTileBlit(kTileBlitReference);
+	for (uint kernel = kTileBlitScalar; kernel < kTileBlitKernelCount; kernel++) {
+		TileBlitProc blit = getTileBlit((TileBlitKernel)kernel);
+		if (!blit) {
+			debugPrintf("%s: not supported\n", getTileBlitName((TileBlitKernel)kernel));
+			continue;
+		}
+
+		uint failed = 0;
+		for (uint i = 0; i < iterations; i++) {
+			// Vary the key density per row, from all key to none
+			for (uint y = 0; y < 32; y++) {
+				uint density = rnd.getRandomNumber(4);
+				for (uint x = 0; x < 32; x++) {
+					byte pixel = rnd.getRandomNumber(255);
+					if (rnd.getRandomNumber(3) < density)
+						pixel = TRANSPARENT;
+					tile[(y * 32) + x] = pixel;
 				}
 			}
+			for (uint j = 0; j < size; j++)
+				expected[j] = actual[j] = rnd.getRandomNumber(255);
+
+			reference(expected + offset, pitch, tile, TRANSPARENT);
+			blit(actual + offset, pitch, tile, TRANSPARENT);
+			if (memcmp(expected, actual, size))
+				failed++;
 		}
+
+		uint32 start = g_system->getMillis();
+		for (uint i = 0; i < iterations; i++)
+			blit(actual + offset, pitch, tile, TRANSPARENT);
+		uint32 elapsed = g_system->getMillis() - start;
+
+		debugPrintf("%s: %d of %d mismatched, %d ms for %d blits\n",
+		            getTileBlitName((TileBlitKernel)kernel), failed, iterations, elapsed, iterations);
 	}
 
-	return false;
+	TileBlitKernel used = _vm->_gfx->getTileBlitKernel();
+	debugPrintf("Drawing uses %s%s\n", getTileBlitName(used),
+	            (used == kTileBlitScalar) ? ", spans for masked tiles" : "");
+	return true;
 }
 
 } // End of namespace Deskadv
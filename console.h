@@ -54,6 +54,8 @@ private:
 	bool cmdPlaySound(int argc, const char **argv);
 	bool cmdStopSound(int argc, const char **argv);
 	bool cmdDrawZone(int argc, const char **argv);
+	bool cmdHotspots(int argc, const char **argv);
+	bool cmdTestBlit(int argc, const char **argv);
 };
 
 } // End of namespace Deskadv
@@ -40,6 +40,8 @@
 
 #include "deskadv/console.h"
 #include "deskadv/deskadv.h"
+#include "deskadv/mappedfile.h"
+#include "deskadv/resourcecache.h"
 
 namespace Deskadv {
 
@@ -56,12 +58,19 @@ DeskadvEngine::DeskadvEngine(OSystem *syst, const DeskadvGameDescription *gameDe
 	SearchMan.addSubDirectoryMatching(gameDataDir, "bitmaps");
 	SearchMan.addSubDirectoryMatching(gameDataDir, "sfx");
 
+	ConfMan.registerDefault("resource_backend", "memory");
+	ConfMan.registerDefault("lazy_zones", false);
+	ConfMan.registerDefault("resource_index", false);
+	ConfMan.registerDefault("resource_threads", true);
+
 	_rnd = new Common::RandomSource("deskadv");
 
 	_console = 0;
 	_gfx = 0;
 	_snd = 0;
 	_resource = 0;
+	_zoneState = 0;
+	_pathfinder = 0;
 
 	// TODO: Add Sound Mixer
 }
@@ -73,7 +82,10 @@ DeskadvEngine::~DeskadvEngine() {
 	delete _console;
 
 	delete _snd;
-	delete _resource;
+	delete _pathfinder;
+	delete _zoneState;
+	if (_resource)
+		ResourceCache::instance().release(_resource);
 	delete _gfx;
 }
 
@@ -83,7 +95,6 @@ Common::Error DeskadvEngine::run() {
 	_gfx = new Gfx(this);
 	_snd = new Sound(this);
 	_console = new DeskadvConsole(this);
-	_resource = new Resource(this);
 
 	Common::String resourceFilename;
 	switch (getGameType()) {
@@ -101,9 +112,40 @@ Common::Error DeskadvEngine::run() {
 		break;
 	}
 	debug(1, "resourceFilename: \"%s\"", resourceFilename.c_str());
-	if (!_resource->load(resourceFilename.c_str(), getGameType() == GType_Yoda))
+
+	// Parse from memory unless another backend is explicitly requested
+	ResourceBackend backend = kResourceBackendMemory;
+	const Common::String &backendName = ConfMan.get("resource_backend");
+	if (backendName == "file")
+		backend = kResourceBackendFile;
+	else if (backendName == "mmap") {
+		if (MappedFile::isSupported())
+			backend = kResourceBackendMmap;
+		else
+			warning("resource_backend \"mmap\" is not supported on this platform, reading into memory");
+	} else if (backendName != "memory")
+		warning("Unknown resource_backend \"%s\"", backendName.c_str());
+
+	uint32 resourceFlags = 0;
+	if (ConfMan.getBool("lazy_zones"))
+		resourceFlags |= kResourceLazyZones;
+	if (ConfMan.getBool("resource_index"))
+		resourceFlags |= kResourceUseIndex;
+	// Turn off for a deterministic, single threaded parse when debugging
+	if (ConfMan.getBool("resource_threads"))
+		resourceFlags |= kResourceThreaded;
+
+	// Engines using the same data file share one parsed copy of it
+	_resource = ResourceCache::instance().acquire(resourceFilename.c_str(), getDataFileMD5(), getGameType() == GType_Yoda, backend, resourceFlags);
+	if (!_resource)
 		error("Loading from Resource File failed!");
 
+	// Show the splash screen while the rest of the resource file loads
+	_gfx->drawScreenOutline();
+	if (_resource->getStupData())
+		_gfx->drawStartup();
+	_gfx->updateScreen();
+
 	// Load Mouse Cursors
 	switch (getGameType()) {
 	case GType_Indy:
@@ -128,11 +170,23 @@ Common::Error DeskadvEngine::run() {
 	//	_gfx->updateScreen();
 	//}
 
-	_gfx->drawScreenOutline();
-
 	bool InvScrollGrabbed = false;
+	bool loading = true;
+	uint loadProgress = 0;
 	while (!shouldQuit()) {
 		//debug(1, "Main Loop Tick...");
+		if (loading) {
+			loading = !_resource->loadNext(40);
+			if (!loading) {
+				_zoneState = new ZoneState(_resource);
+				_pathfinder = new Pathfinder(_zoneState);
+				_gfx->invalidateZoneCache();
+			}
+			if (_resource->getLoadProgress() / 10 != loadProgress / 10) {
+				loadProgress = _resource->getLoadProgress();
+				debug(1, "Loading resources: %d%%", loadProgress);
+			}
+		}
 		_gfx->updateScreen();
 
 		while (_eventMan->pollEvent(event)) {
@@ -167,7 +221,8 @@ Common::Error DeskadvEngine::run() {
 			case Common::EVENT_KEYDOWN:
 				switch (event.kbd.keycode) {
 				case Common::KEYCODE_d:
-					if (event.kbd.hasFlags(Common::KBD_CTRL)) {
+					// The console reads resources still being loaded
+					if (event.kbd.hasFlags(Common::KBD_CTRL) && !loading) {
 						// Start the debugger
 						getDebugger()->attach();
 						getDebugger()->onFrame();
@@ -193,7 +248,7 @@ Common::Error DeskadvEngine::run() {
 			}
 		}
 
-		_system->delayMillis(50);
+		_system->delayMillis(loading ? 10 : 50);
 	}
 
 	return Common::kNoError;
@@ -39,6 +39,8 @@
 #include "deskadv/graphics.h"
 #include "deskadv/sound.h"
 #include "deskadv/resource.h"
+#include "deskadv/pathfind.h"
+#include "deskadv/zonestate.h"
 
 namespace Deskadv {
 
@@ -77,6 +79,7 @@ public:
 	const char *getGameId() const;
 	uint32 getFeatures() const;
 	Common::Language getLanguage() const;
+	const char *getDataFileMD5() const;
 
 	const DeskadvGameDescription *_gameDescription;
 
@@ -85,6 +88,8 @@ public:
 	Gfx *_gfx;
 	Sound *_snd;
 	Resource *_resource;
+	ZoneState *_zoneState; // This session's changes to the zones
+	Pathfinder *_pathfinder;
 
 private:
 	DeskadvConsole *_console;
@@ -52,6 +52,11 @@ Common::Language DeskadvEngine::getLanguage() const {
 	return _gameDescription->desc.language;
 }
 
+const char *DeskadvEngine::getDataFileMD5() const {
+	// The resource file is always listed first
+	return _gameDescription->desc.filesDescriptions[0].md5;
+}
+
 Common::Platform DeskadvEngine::getPlatform() const {
 	return _gameDescription->desc.platform;
 }
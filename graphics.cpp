@@ -40,6 +40,9 @@ namespace Deskadv {
 static const uint screenWidth = 532;
 static const uint screenHeight = 332;
 
+// Past this many dirty rects updateScreen() copies their bounding box
+static const uint kMaxDirtyRects = 32;
+
 // Inventory Scroll Bar
 static const Common::Rect InvScrollOuter(504, 30, 504 + 16, 268);
 static const Common::Rect InvScroll(InvScrollOuter.left, InvScrollOuter.top + 13, InvScrollOuter.right, InvScrollOuter.bottom - 13);
@@ -99,35 +102,104 @@ Gfx::Gfx(DeskadvEngine *vm) : _vm(vm) {
 		error("Font Not Found!");
 
 	InvScrThumb = new Common::Rect();
+
+	_blitKernel = getBestTileBlit();
+	debugC(1, kDebugGraphics, "Tile blit kernel: %s", getTileBlitName(_blitKernel));
+	_blitTile = getTileBlit(_blitKernel);
+	_blitSpans = (_blitKernel == kTileBlitScalar);
+
+	addDirtyRect(Common::Rect(screenWidth, screenHeight));
+
+	_zoneCache = new Graphics::Surface();
+	_zoneCacheState = 0;
+	_zoneCacheZone = 0;
+	_zoneCacheRevision = 0;
 }
 
 Gfx::~Gfx() {
 	_screen->free();
 	delete _screen;
+	_zoneCache->free();
+	delete _zoneCache;
 
 	delete InvScrThumb;
 }
 
 void Gfx::updateScreen(void) {
 	// debugC(1, kDebugGraphics, "Gfx::updateScreen()");
-	_vm->_system->copyRectToScreen((byte *)_screen->getPixels(), _screen->pitch, 0, 0, screenWidth, screenHeight);
+	for (uint i = 0; i < _dirtyRects.size(); i++) {
+		const Common::Rect &r = _dirtyRects[i];
+		_vm->_system->copyRectToScreen(_screen->getBasePtr(r.left, r.top), _screen->pitch, r.left, r.top, r.width(), r.height());
+	}
+	_dirtyRects.clear();
 	_vm->_system->updateScreen();
 }
 
-void Gfx::drawTileInt(uint32 ref, uint x, uint y, byte transparentColor) {
+void Gfx::addDirtyRect(Common::Rect rect) {
+	rect.clip(Common::Rect(screenWidth, screenHeight));
+	if (rect.isEmpty())
+		return;
+
+	// Merge with every rect it overlaps or touches. The union may then
+	// reach rects already passed, so start over after each merge.
+	for (uint i = 0; i < _dirtyRects.size(); ) {
+		const Common::Rect &d = _dirtyRects[i];
+		if (rect.left <= d.right && d.left <= rect.right && rect.top <= d.bottom && d.top <= rect.bottom) {
+			rect.extend(d);
+			_dirtyRects.remove_at(i);
+			i = 0;
+		} else {
+			i++;
+		}
+	}
+
+	if (_dirtyRects.size() >= kMaxDirtyRects) {
+		for (uint i = 0; i < _dirtyRects.size(); i++)
+			rect.extend(_dirtyRects[i]);
+		_dirtyRects.clear();
+	}
+	_dirtyRects.push_back(rect);
+}
+
+void Gfx::drawTileInt(Graphics::Surface *target, uint32 ref, uint x, uint y, byte transparentColor) {
 	debugC(1, kDebugGraphics, "Gfx::drawTileInt(ref: %d, x: %d, y: %d)", ref, x, y);
-	byte *tile = _vm->_resource->getTileData(ref);
-	for (uint dy = 0; dy < 32; dy++) {
-		for (uint dx = 0; dx < 32; dx++) {
-			byte pixel = *(tile + (dy * 32) + dx);
-			if ((pixel != 0 && pixel < 10) || (pixel != 255 && pixel > 245))
-				warning("Gfx::drawTileInt(ref: %d) uses System Palette Index: %d", ref, pixel);
-			debugC(1, kDebugGraphics, "Gfx::drawTileInt x:%d y:%d pixel:%d", x, y, pixel);
-			if (pixel != transparentColor)
-				*((byte *)_screen->getBasePtr(x + dx, y + dy)) = pixel;
+	const byte *tile = _vm->_resource->getTileData(ref);
+	if (!tile)
+		return;
+	assert(x + 32 <= (uint)target->w && y + 32 <= (uint)target->h);
+
+	byte *dst = (byte *)target->getBasePtr(x, y);
+	if (transparentColor != TRANSPARENT) {
+		// The load time analysis is against TRANSPARENT only
+		_blitTile(dst, target->pitch, tile, transparentColor);
+		if (target == _screen)
+			addDirtyRect(Common::Rect(x, y, x + 32, y + 32));
+		return;
+	}
+
+	const TILEINFO *info = _vm->_resource->getTileInfo(ref);
+	if (target == _screen && info->shape != kTileShapeEmpty)
+		addDirtyRect(Common::Rect(x + info->left, y + info->top, x + info->right, y + info->bottom));
+	switch (info->shape) {
+	case kTileShapeEmpty:
+		break;
+	case kTileShapeOpaque:
+		for (uint dy = 0; dy < 32; dy++, tile += 32, dst += target->pitch)
+			memcpy(dst, tile, 32);
+		break;
+	default: {
+		if (!_blitSpans) {
+			_blitTile(dst, target->pitch, tile, transparentColor);
+			break;
 		}
+
+		// Without a vector kernel the spans beat masking every pixel
+		const TILESPAN *span = _vm->_resource->getTileSpans(info);
+		for (uint i = 0; i < info->spanCount; i++, span++)
+			memcpy(dst + (span->y * target->pitch) + span->x, tile + (span->y * 32) + span->x, span->width);
+	}
+	break;
 	}
-	delete[] tile;
 }
 
 void Gfx::loadCursors(const char *filename) {
@@ -246,6 +318,7 @@ void Gfx::loadBMP(const char *filename, uint x, uint y) {
 		// TODO: Format conversion needed?
 		for (uint i = 0; i < image->h; i++)
 			memcpy(_screen->getBasePtr(x, y + i), image->getBasePtr(0, i), image->w);
+		addDirtyRect(Common::Rect(x, y, x + image->w, y + image->h));
 	} else
 		warning("loadBMP failure!");
 	imageFile.close();
@@ -278,6 +351,8 @@ const Common::Rect lWindow(lOptions.right + 15, lOptions.top, lOptions.right + 1
 const Common::Rect lHelp(lWindow.right + 15, lWindow.top, lWindow.right + 15 + (6 * strHelp.size()), lWindow.bottom);
 
 void Gfx::drawScreenOutline(void) {
+	addDirtyRect(Common::Rect(screenWidth, screenHeight));
+
 	Common::Rect rect(1, 1, screenWidth - 1, screenHeight - 1);
 	_screen->fillRect(rect, MEDIUM_GREY);
 	_screen->hLine(0, 18, screenWidth - 1, BLACK);
@@ -427,13 +502,17 @@ void Gfx::drawScreenOutline(void) {
 }
 
 void Gfx::drawStartup(void) {
-	byte *stup = _vm->_resource->getStupData();
+	const byte *stup = _vm->_resource->getStupData();
+	if (!stup) {
+		warning("Gfx::drawStartup() no STUP data");
+		return;
+	}
 	for (uint y = 0; y < 9 * 32; y++) {
 		for (uint x = 0; x < 9 * 32; x++) {
 			*((byte *)_screen->getBasePtr(tileArea.left + x, tileArea.top + y)) = stup[(y * 32 * 9) + x];
 		}
 	}
-	delete[] stup;
+	addDirtyRect(tileArea);
 }
 
 void Gfx::drawTile(uint32 ref, uint8 x, uint8 y) {
@@ -447,11 +526,86 @@ void Gfx::drawTile(uint32 ref, uint8 x, uint8 y) {
 		y = 8;
 	}
 
-	drawTileInt(ref, tileArea.left + (x * 32), tileArea.top + (y * 32), TRANSPARENT);
+	drawTileInt(_screen, ref, tileArea.left + (x * 32), tileArea.top + (y * 32), TRANSPARENT);
+}
+
+void Gfx::drawZone(ZoneState *state, uint zone, uint viewX, uint viewY) {
+	const ZONE *z = state->getResource()->getZone(zone);
+	if (!z)
+		return;
+	const uint cols = MIN<uint>(9, z->width);
+	const uint rows = MIN<uint>(9, z->height);
+	if (viewX + cols > z->width || viewY + rows > z->height) {
+		warning("Gfx::drawZone(%d) view at %d, %d out of range - clamping", zone, viewX, viewY);
+		viewX = MIN<uint>(viewX, z->width - cols);
+		viewY = MIN<uint>(viewY, z->height - rows);
+	}
+
+	updateZoneCache(state, zone);
+
+	_screen->copyRectToSurface(*_zoneCache, tileArea.left, tileArea.top,
+	                           Common::Rect(viewX * 32, viewY * 32, (viewX + cols) * 32, (viewY + rows) * 32));
+	addDirtyRect(Common::Rect(tileArea.left, tileArea.top, tileArea.left + (cols * 32), tileArea.top + (rows * 32)));
+
+	// The roof goes over everything moving in the zone, so it is never
+	// cached
+	const uint16 *roof = state->getLayer(zone, kZoneLayerRoof);
+	for (uint y = 0; y < rows; y++) {
+		for (uint x = 0; x < cols; x++) {
+			uint16 tile = roof[((viewY + y) * z->width) + viewX + x];
+			if (tile != kNoTile)
+				drawTileInt(_screen, tile, tileArea.left + (x * 32), tileArea.top + (y * 32), TRANSPARENT);
+		}
+	}
+}
+
+void Gfx::invalidateZoneCache(void) {
+	_zoneCacheState = 0;
+}
+
+void Gfx::updateZoneCache(ZoneState *state, uint zone) {
+	const ZONE *z = state->getResource()->getZone(zone);
+	bool rebuild = (state != _zoneCacheState || zone != _zoneCacheZone);
+	if (!rebuild && state->getRevision() == _zoneCacheRevision)
+		return;
+
+	const uint cells = z->width * z->height;
+	if (rebuild) {
+		if (_zoneCache->w != z->width * 32 || _zoneCache->h != z->height * 32) {
+			_zoneCache->free();
+			_zoneCache->create(z->width * 32, z->height * 32, Graphics::PixelFormat::createFormatCLUT8());
+		}
+		_zoneCacheTiles.resize(cells);
+		_zoneCacheState = state;
+		_zoneCacheZone = zone;
+	}
+
+	// Only cells whose floor or object tile changed since they were last
+	// rendered are drawn again
+	const uint16 *floor = state->getLayer(zone, kZoneLayerFloor);
+	const uint16 *object = state->getLayer(zone, kZoneLayerObject);
+	uint redrawn = 0;
+	for (uint i = 0; i < cells; i++) {
+		uint32 tiles = floor[i] | ((uint32)object[i] << 16);
+		if (!rebuild && _zoneCacheTiles[i] == tiles)
+			continue;
+		_zoneCacheTiles[i] = tiles;
+
+		uint x = (i % z->width) * 32;
+		uint y = (i / z->width) * 32;
+		_zoneCache->fillRect(Common::Rect(x, y, x + 32, y + 32), BLACK);
+		if (floor[i] != kNoTile)
+			drawTileInt(_zoneCache, floor[i], x, y, TRANSPARENT);
+		if (object[i] != kNoTile)
+			drawTileInt(_zoneCache, object[i], x, y, TRANSPARENT);
+		redrawn++;
+	}
+	debugC(1, kDebugGraphics, "Gfx::updateZoneCache(%d): %d of %d cells redrawn", zone, redrawn, cells);
+	_zoneCacheRevision = state->getRevision();
 }
 
 void Gfx::drawWeapon(uint32 ref) {
-	drawTileInt(ref, weaponArea.left, weaponArea.top, TRANSPARENT);
+	drawTileInt(_screen, ref, weaponArea.left, weaponArea.top, TRANSPARENT);
 }
 
 void Gfx::drawWeaponPower(uint8 level) {
@@ -473,6 +627,7 @@ void Gfx::drawWeaponPower(uint8 level) {
 			color = POWER_BLUE;
 		_screen->hLine(weaponPowerArea.left, weaponPowerArea.bottom - i, weaponPowerArea.right, color);
 	}
+	addDirtyRect(Common::Rect(weaponPowerArea.left, weaponPowerArea.bottom - 31, weaponPowerArea.right + 1, weaponPowerArea.bottom + 1));
 }
 
 void Gfx::eraseInventoryItem(uint slot) {
@@ -480,11 +635,13 @@ void Gfx::eraseInventoryItem(uint slot) {
 	for (uint i = 0; i < slot; i++)
 		InvIcon.translate(0, 34);
 	_screen->fillRect(InvIcon, MEDIUM_GREY);
+	addDirtyRect(InvIcon);
 
 	Common::Rect InvDesc = InvDesc0;
 	for (uint i = 0; i < slot; i++)
 		InvDesc.translate(0, 34);
 	_screen->fillRect(InvDesc, MEDIUM_GREY);
+	addDirtyRect(InvDesc);
 }
 
 void Gfx::drawInventoryItem(uint slot, uint32 iconRef, const char *name) {
@@ -494,7 +651,7 @@ void Gfx::drawInventoryItem(uint slot, uint32 iconRef, const char *name) {
 	}
 
 	eraseInventoryItem(slot);
-	drawTileInt(iconRef, InvIcon0.left, InvIcon0.top + (slot * 34), TRANSPARENT);
+	drawTileInt(_screen, iconRef, InvIcon0.left, InvIcon0.top + (slot * 34), TRANSPARENT);
 	const Common::String n(name);
 	_font->drawString(_screen, n, InvDesc0.left + 5, InvDesc0.top + (slot * 34) + 12, InvDesc0.width() - 10, BLACK, Graphics::kTextAlignLeft, 0, false);
 }
@@ -522,6 +679,8 @@ void Gfx::drawDirectionArrows(bool left, bool up, bool right, bool down) {
 	if (down)
 		colorDown = GREEN;
 
+	addDirtyRect(Common::Rect(LeftArrow.x, UpArrow.y, RightArrow.x + 1, DownArrow.y + 1));
+
 	// Up Arrow
 	for (uint i = 0; i < 7; i++)
 		_screen->drawLine(UpArrow.x - i, UpArrow.y + 1 + i, UpArrow.x + i, UpArrow.y + 1 + i, colorUp);
@@ -564,6 +723,7 @@ void Gfx::viewPalette(void) {
 		else
 			rect.translate(16, 0);
 	}
+	addDirtyRect(Common::Rect(0, 0, 20 * 16, ((256 + 19) / 20) * 12));
 
 	updateScreen();
 }
@@ -33,8 +33,12 @@
 #include "common/winexe_pe.h"
 #include "common/rect.h"
 
+#include "deskadv/blit.h"
+
 namespace Deskadv {
 
+class ZoneState;
+
 class Gfx {
 public:
 	Gfx(DeskadvEngine *vm);
@@ -42,6 +46,11 @@ public:
 
 	void updateScreen(void);
 	void drawTile(uint32 ref, uint8 x, uint8 y);
+	// 9x9 cells of a zone from (viewX, viewY). The floor and object
+	// layers come from a prerendered copy of the zone, redrawn per cell
+	// as its tiles change.
+	void drawZone(ZoneState *state, uint zone, uint viewX, uint viewY);
+	void invalidateZoneCache(void);
 	void loadCursors(const char *filename);
 	void setDefaultCursor(void);
 	void changeCursor(uint id);
@@ -61,11 +70,25 @@ public:
 
 	// Debug Routines
 	void viewPalette(void);
+	TileBlitKernel getTileBlitKernel(void) { return _blitKernel; }
 
 private:
 	DeskadvEngine *_vm;
 
 	Graphics::Surface *_screen;
+	TileBlitKernel _blitKernel;
+	TileBlitProc _blitTile;
+	bool _blitSpans; // Masked tiles from their spans instead of _blitTile
+	// Areas of _screen changed since the last updateScreen()
+	Common::Array<Common::Rect> _dirtyRects;
+
+	// Floor and object layers of one zone, 32x32 pixels per cell
+	Graphics::Surface *_zoneCache;
+	ZoneState *_zoneCacheState; // 0 when the cache is invalid
+	uint _zoneCacheZone;
+	uint32 _zoneCacheRevision;
+	// Floor | (object << 16) tile of every cell as it was rendered
+	Common::Array<uint32> _zoneCacheTiles;
 	Common::NEResources _ne;
 	Common::PEResources _pe;
 	Common::Array<Common::WinResourceID> _cursor;
@@ -74,7 +97,9 @@ private:
 	// Inventory Scroll Bar
 	Common::Rect *InvScrThumb;
 
-	void drawTileInt(uint32 ref, uint x, uint y, byte transparentColor);
+	void addDirtyRect(Common::Rect rect);
+	void drawTileInt(Graphics::Surface *target, uint32 ref, uint x, uint y, byte transparentColor);
+	void updateZoneCache(ZoneState *state, uint zone);
 	void drawShadowFrame(const Common::Rect *rect, bool recessed, bool firstInverse, uint thickness);
 	void drawFrameCircle(Graphics::Surface *target, const Common::Point centre, uint radius, uint color);
 	void drawFilledCircle(Graphics::Surface *target, const Common::Point centre, uint radius, uint color);
@@ -0,0 +1,115 @@
+/* ScummVM - Graphic Adventure Engine
+ *
+ * ScummVM is the legal property of its developers, whose names
+ * are too numerous to list here. Please refer to the COPYRIGHT
+ * file distributed with this source distribution.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * $URL$
+ * $Id$
+ *
+ */
+
+// mmap() and friends are not covered by the OSystem API
+#define FORBIDDEN_SYMBOL_ALLOW_ALL
+
+#include "common/config-manager.h"
+#include "common/fs.h"
+
+#include "deskadv/deskadv.h"
+#include "deskadv/mappedfile.h"
+
+#if defined(POSIX)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace Deskadv {
+
+MappedFile::MappedFile() {
+	_data = 0;
+	_size = 0;
+}
+
+MappedFile::~MappedFile() {
+	close();
+}
+
+bool MappedFile::isSupported() {
+#if defined(POSIX)
+	return true;
+#else
+	return false;
+#endif
+}
+
+bool MappedFile::open(const Common::String &filename) {
+	assert(_data == 0);
+
+#if defined(POSIX)
+	// Resolve the name the same way SearchMan would, ignoring case
+	const Common::FSNode gameDataDir(ConfMan.get("path"));
+	Common::FSList files;
+	if (!gameDataDir.getChildren(files, Common::FSNode::kListFilesOnly))
+		return false;
+
+	Common::String path;
+	for (Common::FSList::const_iterator i = files.begin(); i != files.end(); ++i) {
+		if (i->getName().equalsIgnoreCase(filename)) {
+			path = i->getPath();
+			break;
+		}
+	}
+	if (path.empty())
+		return false;
+
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+		::close(fd);
+		return false;
+	}
+
+	void *map = mmap(0, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	// The mapping stays valid after the descriptor is closed
+	::close(fd);
+	if (map == MAP_FAILED)
+		return false;
+
+	_data = (const byte *)map;
+	_size = st.st_size;
+	debugC(1, kDebugResource, "Mapped \"%s\" (%d bytes)", path.c_str(), _size);
+	return true;
+#else
+	return false;
+#endif
+}
+
+void MappedFile::close() {
+#if defined(POSIX)
+	if (_data)
+		munmap((void *)_data, _size);
+#endif
+	_data = 0;
+	_size = 0;
+}
+
+} // End of namespace Deskadv
@@ -0,0 +1,59 @@
+/* ScummVM - Graphic Adventure Engine
+ *
+ * ScummVM is the legal property of its developers, whose names
+ * are too numerous to list here. Please refer to the COPYRIGHT
+ * file distributed with this source distribution.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * $URL$
+ * $Id$
+ *
+ */
+
+#ifndef DESKADV_MAPPEDFILE_H
+#define DESKADV_MAPPEDFILE_H
+
+#include "common/str.h"
+
+namespace Deskadv {
+
+// Read-only memory mapping of a file in the game directory. Only
+// implemented on POSIX hosts, open() fails everywhere else.
+class MappedFile {
+public:
+	MappedFile();
+	~MappedFile();
+
+	static bool isSupported();
+
+	bool open(const Common::String &filename);
+	void close();
+
+	const byte *getData() const {
+		return _data;
+	}
+	uint32 size() const {
+		return _size;
+	}
+
+private:
+	const byte *_data;
+	uint32 _size;
+};
+
+} // End of namespace Deskadv
+
+#endif
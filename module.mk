@@ -1,13 +1,28 @@
 MODULE := engines/deskadv
 
 MODULE_OBJS = \
+	blit.o \
+	blit-avx2.o \
+	blit-sse2.o \
 	console.o \
 	deskadv.o \
 	detection.o \
 	graphics.o \
+	mappedfile.o \
+	pathfind.o \
 	resource.o \
+	resourcecache.o \
 	saveload.o \
-	sound.o
+	sound.o \
+	stringpool.o \
+	workerpool.o \
+	zonestate.o
+
+# Vector tile kernels, elsewhere their files build to nothing
+ifneq ($(filter i386-% i486-% i586-% i686-% x86_64-% amd64-%,$(shell $(CXX) -dumpmachine)),)
+$(MODULE)/blit-sse2.o: CXXFLAGS += -msse2
+$(MODULE)/blit-avx2.o: CXXFLAGS += -mavx2
+endif
 
 # This module can be built as a plugin
 ifeq ($(ENABLE_DESKADV), DYNAMIC_PLUGIN)
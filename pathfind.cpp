@@ -0,0 +1,145 @@
+/* ScummVM - Graphic Adventure Engine
+ *
+ * ScummVM is the legal property of its developers, whose names
+ * are too numerous to list here. Please refer to the COPYRIGHT
+ * file distributed with this source distribution.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * $URL$
+ * $Id$
+ *
+ */
+
+#include "deskadv/deskadv.h"
+#include "deskadv/pathfind.h"
+
+namespace Deskadv {
+
+static const int kStepX[4] = { 0, 1, 0, -1 };
+static const int kStepY[4] = { -1, 0, 1, 0 };
+
+Pathfinder::Pathfinder(ZoneState *zones) : _zones(zones) {
+	for (uint i = 0; i < kCacheSize; i++)
+		_cache[i].valid = false;
+	_nextSlot = 0;
+}
+
+Pathfinder::~Pathfinder() {
+}
+
+const FlowField *Pathfinder::getFlowField(uint zone, uint targetX, uint targetY, uint32 tick) {
+	const ZONE *z = _zones->getResource()->getZone(zone);
+	if (!z || targetX >= z->width || targetY >= z->height)
+		return 0;
+
+	for (uint i = 0; i < kCacheSize; i++) {
+		const FlowField &field = _cache[i];
+		if (field.valid && field.zone == zone && field.targetX == targetX &&
+		        field.targetY == targetY && field.tick == tick &&
+		        field.revision == _zones->getRevision())
+			return &field;
+	}
+
+	FlowField &field = _cache[_nextSlot];
+	_nextSlot = (_nextSlot + 1) % kCacheSize;
+	field.zone = zone;
+	field.targetX = targetX;
+	field.targetY = targetY;
+	field.width = z->width;
+	field.height = z->height;
+	field.tick = tick;
+	compute(field, z);
+	return &field;
+}
+
+void Pathfinder::compute(FlowField &field, const ZONE *z) {
+	const ZoneBitboards *b = _zones->getBitboards(field.zone);
+	field.revision = _zones->getRevision();
+	field.valid = true;
+
+	const uint cells = z->width * z->height;
+	for (uint i = 0; i < cells; i++)
+		field.distance[i] = kUnreachable;
+
+	// The target itself need not be free, the hero may stand anywhere
+	uint head = 0, tail = 0;
+	uint16 target = (field.targetY * z->width) + field.targetX;
+	field.distance[target] = 0;
+	_queue[tail++] = target;
+	while (head < tail) {
+		uint16 cell = _queue[head++];
+		uint x = cell % z->width;
+		uint y = cell / z->width;
+		for (uint i = 0; i < 4; i++) {
+			uint nx = x + kStepX[i];
+			uint ny = y + kStepY[i];
+			if (nx >= z->width || ny >= z->height)
+				continue;
+			uint16 next = (ny * z->width) + nx;
+			if (field.distance[next] != kUnreachable ||
+			        !testCell(b->walkable, next) || testCell(b->blocking, next))
+				continue;
+			field.distance[next] = field.distance[cell] + 1;
+			_queue[tail++] = next;
+		}
+	}
+	debugC(1, kDebugCollision, "Flow field for zone %d to %d, %d: %d cells reached", field.zone, field.targetX, field.targetY, tail);
+}
+
+bool Pathfinder::getStep(uint zone, uint x, uint y, uint targetX, uint targetY, uint32 tick, int &dx, int &dy) {
+	dx = dy = 0;
+	const FlowField *field = getFlowField(zone, targetX, targetY, tick);
+	if (!field)
+		return false;
+
+	if (x >= field->width || y >= field->height)
+		return false;
+
+	// Downhill, the neighbour closest to the target
+	uint16 best = field->distance[(y * field->width) + x];
+	for (uint i = 0; i < 4; i++) {
+		uint nx = x + kStepX[i];
+		uint ny = y + kStepY[i];
+		if (nx >= field->width || ny >= field->height)
+			continue;
+		uint16 distance = field->distance[(ny * field->width) + nx];
+		if (distance < best) {
+			best = distance;
+			dx = kStepX[i];
+			dy = kStepY[i];
+		}
+	}
+	return dx || dy;
+}
+
+bool Pathfinder::getWanderStep(uint zone, uint x, uint y, Common::RandomSource &rnd, int &dx, int &dy) {
+	dx = dy = 0;
+	uint free[4];
+	uint count = 0;
+	for (uint i = 0; i < 4; i++) {
+		if (_zones->isCellFree(zone, x + kStepX[i], y + kStepY[i]))
+			free[count++] = i;
+	}
+	if (!count)
+		return false;
+
+	uint i = free[rnd.getRandomNumber(count - 1)];
+	dx = kStepX[i];
+	dy = kStepY[i];
+	return true;
+}
+
+} // End of namespace Deskadv
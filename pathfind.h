@@ -0,0 +1,85 @@
+/* ScummVM - Graphic Adventure Engine
+ *
+ * ScummVM is the legal property of its developers, whose names
+ * are too numerous to list here. Please refer to the COPYRIGHT
+ * file distributed with this source distribution.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * $URL$
+ * $Id$
+ *
+ */
+
+#ifndef DESKADV_PATHFIND_H
+#define DESKADV_PATHFIND_H
+
+#include "common/random.h"
+
+#include "deskadv/zonestate.h"
+
+namespace Deskadv {
+
+static const uint16 kUnreachable = 0xFFFF;
+
+// Step distances from every cell of a zone to one target, over the free
+// cells of the zone's collision bitboards
+struct FlowField {
+	uint16 zone;
+	uint16 targetX;
+	uint16 targetY;
+	uint16 width;
+	uint16 height;
+	uint32 tick;
+	uint32 revision; // of the ZoneState it was computed from
+	bool valid;
+	uint16 distance[18 * 18];
+};
+
+// Moves characters towards a target or around a zone. Flow fields are
+// computed breadth first from the target, at most once per zone, target
+// and tick, and shared by every character chasing the same target.
+// Nothing is allocated per query.
+class Pathfinder {
+public:
+	Pathfinder(ZoneState *zones);
+	~Pathfinder();
+
+	const FlowField *getFlowField(uint zone, uint targetX, uint targetY, uint32 tick);
+
+	// Direction of the next step from (x, y) towards the target, false if
+	// it is already there or cannot be reached
+	bool getStep(uint zone, uint x, uint y, uint targetX, uint targetY, uint32 tick, int &dx, int &dy);
+	// A random free neighbour of (x, y), false if there is none
+	bool getWanderStep(uint zone, uint x, uint y, Common::RandomSource &rnd, int &dx, int &dy);
+
+private:
+	// Enough for a few characters chasing different targets in one tick
+	enum {
+		kCacheSize = 4
+	};
+
+	ZoneState *_zones;
+	FlowField _cache[kCacheSize];
+	uint _nextSlot;
+	// Open list of the breadth first search, each cell is queued once
+	uint16 _queue[18 * 18];
+
+	void compute(FlowField &field, const ZONE *z);
+};
+
+} // End of namespace Deskadv
+
+#endif
@@ -24,86 +24,815 @@
  */
 
 #include "common/file.h"
+#include "common/memstream.h"
+#include "common/savefile.h"
+#include "common/system.h"
+#include "common/util.h"
 
 #include "deskadv/deskadv.h"
 #include "deskadv/resource.h"
+#include "deskadv/mappedfile.h"
+#include "deskadv/palette.h"
 
 namespace Deskadv {
 
-Resource::Resource(DeskadvEngine *vm) : _vm(vm) {
-	_file = 0;
+Resource::Resource(const char *md5) : _md5(md5) {
+	_stream = 0;
+	_data = 0;
+	_dataBuffer = 0;
+	_dataSize = 0;
+	_map = 0;
+	_stupOffset = 0;
+	_stupData = 0;
+	_stupBuffer = 0;
 	_tileCount = 0;
 	_tileDataOffset = 0;
+	_tileData = 0;
+	_tileStride = 32 * 32;
+	_tileAtlasBuffer = 0;
+	_zoneCount = 0;
+	_zoneLayerTotal = 0;
+	_zoneWalk.active = false;
+	_zoneWalk.sizing = false;
+	_zoneWalk.next = 0;
+	_flags = 0;
+	_loadState = kLoadIdle;
+	_indexed = false;
+	_abort = false;
+	_zoneActionTotal = 0;
+	_zoneScriptTotal = 0;
+	_zoneTextTotal = 0;
+	_zoneHotspotTotal = 0;
 }
 
 Resource::~Resource() {
-	while (!_zones.empty()) {
-		ZONE *temp = &_zones.back();
-		delete[] temp->tiles[0];
-		delete[] temp->tiles[1];
-		delete[] temp->tiles[2];
-		_zones.pop_back();
+	// Workers still parse into the buffers below
+	{
+		Common::StackLock lock(_abortMutex);
+		_abort = true;
 	}
+	_workers.stop();
+	_strings.setMutex(0);
 
-	if (_file)
-		_file->close();
+	delete _stream;
+	delete[] _dataBuffer;
+	delete _map;
+	delete[] _stupBuffer;
+	delete[] _tileAtlasBuffer;
+}
+
+bool Resource::isAborted(void) {
+	Common::StackLock lock(_abortMutex);
+	return _abort;
+}
+
+bool Resource::load(const char *filename, bool isYoda, ResourceBackend backend, uint32 flags) {
+	if (!open(filename, isYoda, backend, flags))
+		return false;
 
-	delete _file;
+	finishLoad();
+	return true;
 }
 
-bool Resource::load(const char *filename, bool isYoda) {
+bool Resource::open(const char *filename, bool isYoda, ResourceBackend backend, uint32 flags) {
 
 	// Multiple calls of load not supported.
-	assert(_file == 0);
+	assert(_stream == 0);
 
+	_filename = filename;
 	_isYoda = isYoda;
+	_flags = flags;
 
-	_file = new Common::File();
-	if (!_file->open(filename))
-		return false;
+	if (backend == kResourceBackendMmap) {
+		_map = new MappedFile();
+		if (_map->open(filename)) {
+			// Parse straight out of the page cache, STUP and tile data are
+			// served from the mapping without copies.
+			_data = _map->getData();
+			_dataSize = _map->size();
+			_stream = new Common::MemoryReadStream(_data, _dataSize);
+		} else {
+			warning("Resource::load() failed to map \"%s\", reading into memory", filename);
+			delete _map;
+			_map = 0;
+			backend = kResourceBackendMemory;
+		}
+	}
+
+	Common::File *file = 0;
+	if (!_stream) {
+		file = new Common::File();
+		if (!file->open(filename)) {
+			delete file;
+			return false;
+		}
+	}
+
+	switch (backend) {
+	case kResourceBackendFile:
+		debugC(1, kDebugResource, "Streaming \"%s\" from file", filename);
+		_stream = file;
+		break;
+	case kResourceBackendMemory:
+		// Read the whole file in one go and parse it from memory. STUP data
+		// is then served directly out of this buffer.
+		_dataSize = file->size();
+		debugC(1, kDebugResource, "Reading \"%s\" into memory (%d bytes)", filename, _dataSize);
+		_dataBuffer = new byte[_dataSize];
+		if (file->read(_dataBuffer, _dataSize) != _dataSize) {
+			warning("Resource::load() short read of \"%s\"", filename);
+			delete file;
+			return false;
+		}
+		delete file;
+		_data = _dataBuffer;
+		_stream = new Common::MemoryReadStream(_data, _dataSize);
+		break;
+	case kResourceBackendMmap:
+		break;
+	default:
+		error("Resource::load() unknown backend %d", backend);
+		break;
+	}
+
+	// Sections can be decoded in parallel once their offsets are known,
+	// either from the index or from a quick scan of the top level.
+	_indexed = (_flags & kResourceUseIndex) && loadIndex();
+	if (!_indexed && (_flags & kResourceThreaded) && _data && WorkerPool::isSupported())
+		scanSections();
+
+	if (_sections.empty()) {
+		// Walk the file one section at a time, STUP comes right after VERS
+		_loadState = kLoadWalk;
+		while (!_stupData && _loadState == kLoadWalk)
+			walkSection();
+		return true;
+	}
+
+	// Only the splash screen is needed right away
+	for (uint i = 0; i < _sections.size(); i++) {
+		if (_sections[i].tag == MKTAG('V', 'E', 'R', 'S') || _sections[i].tag == MKTAG('S', 'T', 'U', 'P'))
+			parseSection(_stream, i, 0);
+	}
+	startSections();
+	return true;
+}
+
+bool Resource::loadNext(uint32 budget) {
+	Common::StackLock lock(_accessMutex);
+	uint32 start = g_system->getMillis();
+	do {
+		switch (_loadState) {
+		case kLoadWalk:
+			walkSection();
+			break;
+		case kLoadSections:
+			if (_workers.poll())
+				finishSections();
+			else if (_flags & kResourceThreaded)
+				return false; // nothing to do but wait
+			break;
+		default:
+			break;
+		}
+	} while (_loadState != kLoadDone && g_system->getMillis() - start < budget);
+
+	return _loadState == kLoadDone;
+}
+
+void Resource::finishLoad(void) {
+	Common::StackLock lock(_accessMutex);
+	while (_loadState == kLoadWalk)
+		walkSection();
+	if (_loadState == kLoadSections) {
+		_workers.wait();
+		finishSections();
+	}
+}
+
+uint Resource::getLoadProgress(void) {
+	Common::StackLock lock(_accessMutex);
+	switch (_loadState) {
+	case kLoadWalk:
+		// Do not run ahead while adding up the zones, the walk goes back
+		if (_zoneWalk.sizing)
+			return _zoneWalk.start * 100 / _stream->size();
+		return _stream->pos() * 100 / _stream->size();
+	case kLoadSections:
+		return _workers.getCount() ? _workers.getFinished() * 100 / _workers.getCount() : 100;
+	default:
+		return 100;
+	}
+}
+
+void Resource::walkSection(void) {
+	if (isAborted()) {
+		_loadState = kLoadDone;
+		return;
+	}
+
+	ParseContext ctx(_stream);
+
+	// ZONE is most of the file, it is walked one zone per step
+	if (_zoneWalk.active) {
+		if (_zoneWalk.next < _zoneCount)
+			walkZone(ctx);
+		if (_zoneWalk.next >= _zoneCount) {
+			endZones();
+			_zoneWalk.active = false;
+		}
+		return;
+	}
+
+	SECTION section;
+	section.offset = _stream->pos();
+	if (_stream->readUint32BE() == MKTAG('Z', 'O', 'N', 'E')) {
+		section.tag = MKTAG('Z', 'O', 'N', 'E');
+		_sections.push_back(section);
+		beginZones(ctx);
+		_zoneWalk.active = true;
+		return;
+	}
+	_stream->seek(section.offset, SEEK_SET);
+
+	section.tag = this->readTag(ctx);
+	_sections.push_back(section);
+	if (section.tag == MKTAG('E', 'N', 'D', 'F'))
+		loadDone();
+}
+
+bool Resource::scanSections(void) {
+	ParseContext ctx(_stream);
 
 	uint32 tag;
 	do {
-		tag = this->readTag();
-	} while (!_vm->shouldQuit() && tag != MKTAG('E', 'N', 'D', 'F'));
+		SECTION section;
+		section.offset = _stream->pos();
+		tag = _stream->readUint32BE();
+		section.tag = tag;
+		_sections.push_back(section);
+
+		switch (tag) {
+		case MKTAG('V', 'E', 'R', 'S'):
+			_stream->seek(sizeof(uint32), SEEK_CUR); // version
+			break;
+		case MKTAG('E', 'N', 'D', 'F'):
+			break;
+		case MKTAG('T', 'I', 'L', 'E'): {
+			uint32 size = _stream->readUint32LE();
+			_tileCount = size / 1028;
+			_stream->seek(size, SEEK_CUR);
+		}
+		break;
+		case MKTAG('Z', 'O', 'N', 'E'): {
+			// Yoda has no section size, step over the zones one by one
+			if (!_isYoda)
+				_stream->seek(sizeof(uint32), SEEK_CUR);
+			_zoneCount = _stream->readUint16LE();
+			_zoneLayerTotal = 0;
+			for (uint i = 0; i < _zoneCount; i++) {
+				if (_isYoda)
+					_stream->seek(2 + 4 + 2, SEEK_CUR); // planet, size, id
+				ZONE z;
+				skipZone(ctx, &z);
+				_zoneLayerTotal += z.width * z.height * 3;
+			}
+			resizeZones();
+		}
+		break;
+		case MKTAG('S', 'T', 'U', 'P'):
+		case MKTAG('S', 'N', 'D', 'S'):
+		case MKTAG('Z', 'A', 'U', 'X'):
+		case MKTAG('Z', 'A', 'X', '2'):
+		case MKTAG('Z', 'A', 'X', '3'):
+		case MKTAG('Z', 'A', 'X', '4'):
+		case MKTAG('C', 'H', 'W', 'P'):
+		case MKTAG('C', 'A', 'U', 'X'):
+		case MKTAG('P', 'N', 'A', 'M'):
+		case MKTAG('A', 'N', 'A', 'M'):
+		case MKTAG('T', 'N', 'A', 'M'):
+		case MKTAG('Z', 'N', 'A', 'M'):
+		case MKTAG('C', 'H', 'A', 'R'):
+		case MKTAG('A', 'C', 'T', 'N'):
+		case MKTAG('H', 'T', 'S', 'P'):
+		case MKTAG('P', 'U', 'Z', '2'): {
+			uint32 size = _stream->readUint32LE();
+			_stream->seek(size, SEEK_CUR);
+		}
+		break;
+		default:
+			warning("Resource::scanSections() unknown tag %s at %d", tag2str(tag), section.offset);
+			tag = 0;
+			break;
+		}
+	} while (tag && tag != MKTAG('E', 'N', 'D', 'F') && !_stream->eos() && !isAborted());
+
+	if (tag != MKTAG('E', 'N', 'D', 'F')) {
+		// Leave it to the serial parse
+		_sections.clear();
+		_tileCount = 0;
+		_zoneCount = 0;
+		_zoneLayerTotal = 0;
+		_zones.clear();
+		_stream->seek(0, SEEK_SET);
+		return false;
+	}
+
+	debugC(1, kDebugResource, "Scanned %d sections", _sections.size());
+	_stream->seek(0, SEEK_SET);
+	return true;
+}
+
+bool Resource::isIndexedSection(uint32 tag) {
+	switch (tag) {
+	case MKTAG('Z', 'O', 'N', 'E'):
+	case MKTAG('T', 'N', 'A', 'M'):
+	case MKTAG('Z', 'N', 'A', 'M'):
+	case MKTAG('A', 'N', 'A', 'M'):
+	case MKTAG('P', 'N', 'A', 'M'):
+	case MKTAG('S', 'N', 'D', 'S'):
+		return true;
+	default:
+		return false;
+	}
+}
+
+void Resource::startSections(void) {
+	// Everything the index does not cover is parsed straight from its
+	// recorded section offset. open() already did the splash screen.
+	uint32 stringSize = 0;
+	for (uint i = 0; i < _sections.size(); i++) {
+		uint32 tag = _sections[i].tag;
+		if (tag == MKTAG('E', 'N', 'D', 'F') || tag == MKTAG('V', 'E', 'R', 'S') ||
+		        tag == MKTAG('S', 'T', 'U', 'P') || (_indexed && isIndexedSection(tag)))
+			continue;
+
+		SectionJob job;
+		job.resource = this;
+		job.section = i;
+		job.size = ((i + 1 < _sections.size()) ? _sections[i + 1].offset : (uint32)_stream->size()) - _sections[i].offset;
+		if (tag != MKTAG('T', 'I', 'L', 'E'))
+			stringSize += job.size;
+		_jobs.push_back(job);
+	}
+
+	// Without threads the jobs run from loadNext(), serially and in file
+	// order on the shared stream
+	bool threaded = (_flags & kResourceThreaded) && _data && WorkerPool::isSupported();
+	if (!threaded)
+		_flags &= ~kResourceThreaded;
+
+	for (uint i = 0; i < _jobs.size(); i++) {
+		if (!threaded) {
+			_jobArgs.push_back(&_jobs[i]);
+			continue;
+		}
+		// Start the largest sections first, TILE and ZONE dominate
+		uint j = _jobArgs.size();
+		_jobArgs.push_back(0);
+		for (; j > 0 && ((SectionJob *)_jobArgs[j - 1])->size < _jobs[i].size; j--)
+			_jobArgs[j] = _jobArgs[j - 1];
+		_jobArgs[j] = &_jobs[i];
+	}
+
+	if (threaded) {
+		// A string never takes more room in the pool than its field in the
+		// file, bar the terminator of a completely filled fixed width name.
+		// Reserved like this the pool does not move while the workers add
+		// to it, so their get() calls stay safe.
+		_strings.reserve(_strings.size() + stringSize + (stringSize / 16));
+		_strings.setMutex(&_stringMutex);
+	}
+
+	_loadState = kLoadSections;
+	_workers.start(parseSectionProc, _jobArgs.begin(), _jobArgs.size(), threaded);
+}
+
+void Resource::finishSections(void) {
+	_workers.wait();
+	_strings.setMutex(0);
+	for (uint i = 0; i < _jobs.size(); i++) {
+		const Common::Array<LogLine> &log = _jobs[i].log;
+		for (uint j = 0; j < log.size(); j++) {
+			if (log[j].warning)
+				warning("%s", log[j].text.c_str());
+			else
+				debugC(1, kDebugResource, "%s", log[j].text.c_str());
+		}
+	}
+	_jobs.clear();
+	_jobArgs.clear();
+	loadDone();
+}
+
+void Resource::loadDone(void) {
+	if (!_indexed && (_flags & kResourceUseIndex) && !isAborted())
+		saveIndex();
+
+	// Zones decoded later, by any engine sharing this, append into
+	// reserved space. Pointers handed out before stay valid.
+	if (_indexed || (_flags & kResourceLazyZones)) {
+		_actions.reserve(_actions.size() + _zoneActionTotal);
+		_scripts.reserve(_scripts.size() + _zoneScriptTotal);
+		_strings.reserve(_strings.size() + _zoneTextTotal);
+		_hotspots.reserve(_hotspots.size() + _zoneHotspotTotal);
+		_hotspotNext.reserve(_hotspotNext.size() + _zoneHotspotTotal);
+	}
+
+	// HTSP is parsed independently of the zones, their sizes are only
+	// all known now
+	uint32 gridCells = 0;
+	for (uint i = 0; i < _zones.size(); i++) {
+		if (_zones[i].hotspotCount && _zones[i].hotspotGrid == kNoHotspotGrid)
+			gridCells += _zones[i].width * _zones[i].height;
+	}
+	_hotspotGrids.reserve(_hotspotGrids.size() + gridCells);
+	for (uint i = 0; i < _zones.size(); i++) {
+		if (_zones[i].hotspotCount && _zones[i].hotspotGrid == kNoHotspotGrid)
+			buildHotspotGrid(_zones[i]);
+	}
+
+	// CHAR may be parsed before TILE
+	resolveCharacterFrames();
+	reportWarnings();
+	_loadState = kLoadDone;
+}
+
+void Resource::reportWarnings(void) {
+	for (uint i = 0; i < _tileWarnings.size(); i++)
+		warning("Resource: %s", _tileWarnings[i].c_str());
+	for (uint i = 0; i < _zoneWarnings.size(); i++)
+		warning("Resource: %s", _zoneWarnings[i].c_str());
+	_tileWarnings.clear();
+	_zoneWarnings.clear();
+}
+
+void Resource::parseSectionProc(void *arg) {
+	SectionJob *job = (SectionJob *)arg;
+	Resource *resource = job->resource;
+	if (!(resource->_flags & kResourceThreaded)) {
+		resource->parseSection(resource->_stream, job->section, 0);
+		return;
+	}
+
+	// Each worker parses from its own stream over the file in memory
+	Common::MemoryReadStream stream(resource->_data, resource->_dataSize);
+	resource->parseSection(&stream, job->section, &job->log);
+}
+
+void Resource::parseSection(Common::SeekableReadStream *stream, uint section, Common::Array<LogLine> *log) {
+	if (isAborted())
+		return;
+
+	ParseContext ctx(stream);
+	ctx.log = log;
+	stream->seek(_sections[section].offset, SEEK_SET);
+	uint32 tag = this->readTag(ctx);
+	assert(tag == _sections[section].tag);
+}
+
+void Resource::parseDebug(ParseContext &ctx, const char *s, ...) {
+	if (gDebugLevel < 1 || !DebugMan.isDebugChannelEnabled(kDebugResource))
+		return;
+
+	char buf[1024];
+	va_list va;
+	va_start(va, s);
+	vsnprintf(buf, sizeof(buf), s, va);
+	va_end(va);
+
+	if (!ctx.log) {
+		debugC(1, kDebugResource, "%s", buf);
+		return;
+	}
+	LogLine line;
+	line.warning = false;
+	line.text = buf;
+	ctx.log->push_back(line);
+}
+
+void Resource::parseWarning(ParseContext &ctx, const char *s, ...) {
+	char buf[1024];
+	va_list va;
+	va_start(va, s);
+	vsnprintf(buf, sizeof(buf), s, va);
+	va_end(va);
+
+	if (!ctx.log) {
+		warning("%s", buf);
+		return;
+	}
+	LogLine line;
+	line.warning = true;
+	line.text = buf;
+	ctx.log->push_back(line);
+}
+
+/* resource index format
+ *
+ * [4] 'DAIX'
+ * [4] index version
+ * [4] resource file size
+ * [32] resource file md5 from the detection table
+ * [1] isYoda
+ * [4] section count
+ *     [4] tag
+ *     [4] offset of tag
+ * [4] tile count
+ * [2] zone count
+ *     [4] offset of IZON tag
+ *     [2] width
+ *     [2] height
+ * [4] actions in all zones
+ * [4] scripts in all zones
+ * [4] script text bytes in all zones
+ * [4] hotspots in all zones
+ * name table (tile names)
+ * name table (zone names)
+ * name table (puzzle names)
+ * name table (sound files)
+ * [4] action name count
+ *     [2] zone
+ *     [2] action
+ *     string
+ *
+ * name table :=
+ * [4] count
+ *     string
+ *
+ * string :=
+ * [2] length, 0xFFFF for none
+ * [length] characters
+ */
+
+static const uint32 kIndexVersion = 3;
+
+Common::String Resource::getIndexFilename(void) {
+	// The md5 alone is not unique, some demos ship the full data file
+	// under another name
+	Common::String base;
+	for (uint i = 0; i < _filename.size() && _filename[i] != '.'; i++) {
+		if (Common::isAlnum(_filename[i]))
+			base += _filename[i];
+	}
+	base.toLowercase();
+	return Common::String::format("deskadv-%s-%s.idx", base.c_str(), _md5.c_str());
+}
+
+void Resource::writeIndexString(Common::WriteStream *out, StringRef ref) {
+	const char *str = _strings.get(ref);
+	if (!str) {
+		out->writeUint16LE(0xFFFF);
+		return;
+	}
+	uint16 len = strlen(str);
+	out->writeUint16LE(len);
+	out->write(str, len);
+}
+
+bool Resource::readIndexString(Common::SeekableReadStream *in, StringRef &ref) {
+	uint16 len = in->readUint16LE();
+	ref = kNoString;
+	if (len == 0xFFFF)
+		return !in->eos();
+	if (in->eos() || len > in->size() - in->pos())
+		return false;
+	ref = _strings.read(in, len);
+	return true;
+}
+
+void Resource::writeIndexNames(Common::WriteStream *out, const Common::Array<StringRef> &names) {
+	out->writeUint32LE(names.size());
+	for (uint32 i = 0; i < names.size(); i++)
+		writeIndexString(out, names[i]);
+}
+
+bool Resource::readIndexNames(Common::SeekableReadStream *in, Common::Array<StringRef> &names) {
+	uint32 count;
+	if (!readIndexCount(in, 2, count))
+		return false;
+	names.resize(count);
+	for (uint32 i = 0; i < count; i++) {
+		if (!readIndexString(in, names[i]))
+			return false;
+	}
+	return true;
+}
+
+bool Resource::readIndexCount(Common::SeekableReadStream *in, uint32 entrySize, uint32 &count) {
+	// Nothing in the data file occurs more often than it has bytes, and
+	// every entry takes entrySize bytes of the index
+	count = in->readUint32LE();
+	return !in->eos() && count <= (uint32)_stream->size() &&
+	       count <= (uint32)(in->size() - in->pos()) / entrySize;
+}
+
+bool Resource::loadIndex(void) {
+	Common::String filename = getIndexFilename();
+	Common::InSaveFile *in = g_system->getSavefileManager()->openForLoading(filename);
+	if (!in)
+		return false;
+
+	char md5[32];
+	bool valid = in->readUint32BE() == MKTAG('D', 'A', 'I', 'X') &&
+	             in->readUint32LE() == kIndexVersion &&
+	             in->readUint32LE() == (uint32)_stream->size() &&
+	             in->read(md5, 32) == 32 &&
+	             !strncmp(md5, _md5.c_str(), 32) &&
+	             in->readByte() == (_isYoda ? 1 : 0);
+	if (!valid) {
+		debugC(1, kDebugResource, "Resource index \"%s\" is stale", filename.c_str());
+		delete in;
+		return false;
+	}
+
+	valid = readIndex(in);
+	delete in;
+	if (!valid) {
+		warning("Resource::loadIndex() \"%s\" is damaged", filename.c_str());
+		// Drop the partial state, the full parse rebuilds it
+		_sections.clear();
+		_tileCount = 0;
+		_zoneCount = 0;
+		_zones.clear();
+		_zoneLayers.clear();
+		_hotspotGrids.clear();
+		_tileNames.clear();
+		_zoneNames.clear();
+		_puzzleNames.clear();
+		_soundFiles.clear();
+		_actionNames.clear();
+		_zoneActionTotal = 0;
+		_zoneScriptTotal = 0;
+		_zoneTextTotal = 0;
+		_zoneHotspotTotal = 0;
+		return false;
+	}
+
+	debugC(1, kDebugResource, "Loaded resource index \"%s\"", filename.c_str());
+	return true;
+}
 
+bool Resource::readIndex(Common::SeekableReadStream *in) {
+	const uint32 dataSize = _stream->size();
+	uint32 count;
+
+	if (!readIndexCount(in, 8, count))
+		return false;
+	_sections.resize(count);
+	for (uint i = 0; i < _sections.size(); i++) {
+		_sections[i].tag = in->readUint32BE();
+		_sections[i].offset = in->readUint32LE();
+		if (_sections[i].offset >= dataSize)
+			return false;
+	}
+
+	// The TILE section itself is parsed again for the pixels and flags,
+	// this is only needed to size the name index.
+	_tileCount = in->readUint32LE();
+	if (_tileCount > dataSize / (32 * 32))
+		return false;
+
+	uint16 zoneCount = in->readUint16LE();
+	if (in->eos() || zoneCount > (in->size() - in->pos()) / 8)
+		return false;
+	_zoneCount = zoneCount;
+	resizeZones();
+	uint32 layerArenaSize = 0;
+	for (uint i = 0; i < _zoneCount; i++) {
+		ZONE &z = _zones[i];
+		z.offset = in->readUint32LE();
+		z.width = in->readUint16LE();
+		z.height = in->readUint16LE();
+		if (z.offset >= dataSize || (z.width != 9 && z.width != 18) || (z.height != 9 && z.height != 18))
+			return false;
+		layerArenaSize += z.width * z.height * 3;
+	}
+	_zoneActionTotal = in->readUint32LE();
+	_zoneScriptTotal = in->readUint32LE();
+	_zoneTextTotal = in->readUint32LE();
+	_zoneHotspotTotal = in->readUint32LE();
+	// loadDone() reserves the tables by these
+	if (_zoneActionTotal > dataSize || _zoneScriptTotal > dataSize ||
+	        _zoneTextTotal > dataSize || _zoneHotspotTotal > dataSize)
+		return false;
+
+	if (!readIndexNames(in, _tileNames) || !readIndexNames(in, _zoneNames) ||
+	        !readIndexNames(in, _puzzleNames) || !readIndexNames(in, _soundFiles))
+		return false;
+
+	if (!readIndexCount(in, 6, count))
+		return false;
+	_actionNames.resize(count);
+	for (uint i = 0; i < _actionNames.size(); i++) {
+		_actionNames[i].zone = in->readUint16LE();
+		_actionNames[i].action = in->readUint16LE();
+		if (!readIndexString(in, _actionNames[i].name))
+			return false;
+	}
+
+	if (in->err() || in->eos())
+		return false;
+
+	// Only reserved once everything checked out
+	_zoneLayers.reserve(layerArenaSize);
+	_hotspotGrids.reserve(layerArenaSize / 3);
 	return true;
 }
 
-uint32 Resource::readTag(void) {
-	assert(_file != 0);
+void Resource::saveIndex(void) {
+	Common::String filename = getIndexFilename();
+	Common::OutSaveFile *out = g_system->getSavefileManager()->openForSaving(filename);
+	if (!out) {
+		warning("Resource::saveIndex() could not create \"%s\"", filename.c_str());
+		return;
+	}
 
-	uint32 tag = _file->readUint32BE();
+	out->writeUint32BE(MKTAG('D', 'A', 'I', 'X'));
+	out->writeUint32LE(kIndexVersion);
+	out->writeUint32LE(_stream->size());
+	out->write(_md5.c_str(), 32);
+	out->writeByte(_isYoda ? 1 : 0);
+
+	out->writeUint32LE(_sections.size());
+	for (uint i = 0; i < _sections.size(); i++) {
+		out->writeUint32BE(_sections[i].tag);
+		out->writeUint32LE(_sections[i].offset);
+	}
+
+	out->writeUint32LE(_tileCount);
+
+	out->writeUint16LE(_zoneCount);
+	for (uint i = 0; i < _zoneCount; i++) {
+		out->writeUint32LE(_zones[i].offset);
+		out->writeUint16LE(_zones[i].width);
+		out->writeUint16LE(_zones[i].height);
+	}
+	out->writeUint32LE(_zoneActionTotal);
+	out->writeUint32LE(_zoneScriptTotal);
+	out->writeUint32LE(_zoneTextTotal);
+	out->writeUint32LE(_zoneHotspotTotal);
+
+	writeIndexNames(out, _tileNames);
+	writeIndexNames(out, _zoneNames);
+	writeIndexNames(out, _puzzleNames);
+	writeIndexNames(out, _soundFiles);
+
+	out->writeUint32LE(_actionNames.size());
+	for (uint i = 0; i < _actionNames.size(); i++) {
+		out->writeUint16LE(_actionNames[i].zone);
+		out->writeUint16LE(_actionNames[i].action);
+		writeIndexString(out, _actionNames[i].name);
+	}
+
+	out->finalize();
+	if (out->err())
+		warning("Resource::saveIndex() failed writing \"%s\"", filename.c_str());
+	else
+		debugC(1, kDebugResource, "Saved resource index \"%s\"", filename.c_str());
+	delete out;
+}
+
+uint32 Resource::readTag(ParseContext &ctx) {
+	Common::SeekableReadStream *stream = ctx.stream;
+	assert(stream != 0);
+
+	uint32 tag = stream->readUint32BE();
 	switch (tag) {
 	case MKTAG('V', 'E', 'R', 'S'): {
-		uint32 version = _file->readUint32LE();
-		debugC(1, kDebugResource, "Version: %d", version);
+		uint32 version = stream->readUint32LE();
+		parseDebug(ctx, "Version: %d", version);
 		if (version != 0x200)
-			warning("Unsupported Version");
+			parseWarning(ctx, "Unsupported Version");
 	}
 	break;
 	case MKTAG('E', 'N', 'D', 'F'):
-		debugC(1, kDebugResource, "End of File");
+		parseDebug(ctx, "End of File");
 		break;
 	case MKTAG('S', 'T', 'U', 'P'): {
-		uint32 size = _file->readUint32LE();
+		uint32 size = stream->readUint32LE();
 		assert(size == 32 * 32 * 9 * 9);
-		_stupOffset = _file->pos();
-		_file->seek(size, SEEK_CUR);
+		_stupOffset = stream->pos();
+		if (_data) {
+			_stupData = _data + _stupOffset;
+			stream->seek(size, SEEK_CUR);
+		} else {
+			_stupBuffer = new byte[size];
+			stream->read(_stupBuffer, size);
+			_stupData = _stupBuffer;
+		}
 	}
 	break;
 	case MKTAG('S', 'N', 'D', 'S'): {
-		_file->seek(sizeof(uint32), SEEK_CUR); // skip size;
-		int16 count = _file->readSint16LE();
+		uint32 size = stream->readUint32LE();
+		if (!_strings.isShared()) // startSections() reserved for all
+			_strings.reserve(_strings.size() + size);
+		int16 count = stream->readSint16LE();
 		assert(count <= 0);
 		while (count++) {
-			uint16 strsize = _file->readUint16LE();
-			Common::String strname;
-			// TODO: read sound name in one batch
-			char c;
-			while ((c = _file->readByte()) != 0 && strname.size() < strsize)
-				strname += c;
-			debugC(1, kDebugResource, "Sound \"%s\"", strname.c_str());
+			uint16 strsize = stream->readUint16LE();
+			StringRef strname = _strings.read(stream, strsize);
+			parseDebug(ctx, "Sound \"%s\"", _strings.get(strname));
 			_soundFiles.push_back(strname);
 		}
 	}
@@ -112,10 +841,10 @@ uint32 Resource::readTag(void) {
 	case MKTAG('Z', 'A', 'X', '2'): // intentional fallthorugh
 	case MKTAG('Z', 'A', 'X', '3'): // intentional fallthrough
 	case MKTAG('Z', 'A', 'X', '4'): {
-		_file->seek(sizeof(uint32), SEEK_CUR); // skip size;
+		stream->seek(sizeof(uint32), SEEK_CUR); // skip size;
 		uint32 lastTag = 0;
-		for (uint zoneID = 0; zoneID < _zoneCount && !_vm->shouldQuit(); zoneID++) {
-			lastTag = this->readTag();
+		for (uint zoneID = 0; zoneID < _zoneCount && !isAborted(); zoneID++) {
+			lastTag = this->readTag(ctx);
 			assert(lastTag == MKTAG('I', 'Z', 'A', 'X') ||
 			       lastTag == MKTAG('I', 'Z', 'X', '2') ||
 			       lastTag == MKTAG('I', 'Z', 'X', '3') ||
@@ -126,275 +855,307 @@ uint32 Resource::readTag(void) {
 	case MKTAG('I', 'Z', 'A', 'X'): // intentional fallthorugh
 	case MKTAG('I', 'Z', 'X', '2'): // intentional fallthrough
 	case MKTAG('I', 'Z', 'X', '3'): {
-		int size = _file->readUint16LE() - 4 - 2;
-		_file->seek(size, SEEK_CUR);
+		int size = stream->readUint16LE() - 4 - 2;
+		stream->seek(size, SEEK_CUR);
 	}
 	break;
 	case MKTAG('I', 'Z', 'X', '4'):
-		_file->seek(6, SEEK_CUR);
+		stream->seek(6, SEEK_CUR);
 		break;
 	case MKTAG('C', 'H', 'W', 'P'): {
-		_file->seek(sizeof(uint32), SEEK_CUR); // skip size;
+		stream->seek(sizeof(uint32), SEEK_CUR); // skip size;
 		uint16_t index = 0xFFFF;
-		while (!_vm->shouldQuit() && (index = _file->readUint16LE()) != 0xFFFF) {
+		while (!isAborted() && (index = stream->readUint16LE()) != 0xFFFF) {
 			uint8 weaponData[4];
-			_file->read(weaponData, 4);
+			stream->read(weaponData, 4);
 		}
 	}
 	break;
 	case MKTAG('C', 'A', 'U', 'X'): {
-		_file->seek(sizeof(uint32), SEEK_CUR); // skip size;
+		stream->seek(sizeof(uint32), SEEK_CUR); // skip size;
 		uint16_t index = 0xFFFF;
-		while (!_vm->shouldQuit() && (index = _file->readUint16LE()) != 0xFFFF) {
+		while (!isAborted() && (index = stream->readUint16LE()) != 0xFFFF) {
 			uint8 auxData[2];
-			_file->read(auxData, 2);
+			stream->read(auxData, 2);
 		}
 	}
 	break;
 	case MKTAG('P', 'N', 'A', 'M'): {
-		uint32 size = _file->readUint32LE();
-		debugC(1, kDebugResource, "Found %s tag, size %d", tag2str(tag), size);
-		uint16 count = _file->readUint16LE();
+		uint32 size = stream->readUint32LE();
+		parseDebug(ctx, "Found %s tag, size %d", tag2str(tag), size);
+		if (!_strings.isShared())
+			_strings.reserve(_strings.size() + size);
+		uint16 count = stream->readUint16LE();
 		for (uint i = 0; i < count; i++) {
-			// TODO: read name in one batch
-			Common::String name;
-			for (uint16 j = 0; j < 16; j++)
-				name += _file->readByte();
-			name = name.c_str(); // Drop extra trailing nulls
-			debugC(1, kDebugResource, "entry %04x (%d) is \"%s\"", i, i,
-			       name.c_str());
+			StringRef name = _strings.read(stream, 16);
+			parseDebug(ctx, "entry %04x (%d) is \"%s\"", i, i,
+			       _strings.get(name));
+			_puzzleNames.push_back(name);
 		}
 	}
 	break;
 	case MKTAG('A', 'N', 'A', 'M'): {
-		_file->seek(sizeof(uint32), SEEK_CUR); // skip size;
-		while (!_vm->shouldQuit()) {
-			uint16 zoneid = _file->readUint16LE();
+		uint32 size = stream->readUint32LE();
+		if (!_strings.isShared())
+			_strings.reserve(_strings.size() + size);
+		uint16 len = _isYoda ? 24 : 16;
+		while (!isAborted()) {
+			uint16 zoneid = stream->readUint16LE();
 			if (zoneid == 0xffff)
 				break;
-			debugC(1, kDebugResource, "entry for zone %04x (%d)", zoneid, zoneid);
-			while (!_vm->shouldQuit()) {
-				uint16 id = _file->readUint16LE();
+			parseDebug(ctx, "entry for zone %04x (%d)", zoneid, zoneid);
+			while (!isAborted()) {
+				uint16 id = stream->readUint16LE();
 				if (id == 0xffff)
 					break;
-				Common::String name;
-				uint16 len = _isYoda ? 24 : 16;
-				for (uint16 i = 0; i < len; i++)
-					name += _file->readByte();
-				name = name.c_str(); // Drop extra trailing nulls
-				debugC(1, kDebugResource, "entry id %04x (%d) is \"%s\"", id, id,
-				       name.c_str());
+				ACTIONNAME a;
+				a.zone = zoneid;
+				a.action = id;
+				a.name = _strings.read(stream, len);
+				parseDebug(ctx, "entry id %04x (%d) is \"%s\"", id, id,
+				       _strings.get(a.name));
+				_actionNames.push_back(a);
 			}
 		}
 	}
 	break;
 	case MKTAG('T', 'N', 'A', 'M'): { // Tile Names
-		_file->seek(sizeof(uint32), SEEK_CUR); // skip size;
-		while (!_vm->shouldQuit()) {
-			TNAME t;
-			t.id = _file->readUint16LE();
-			if (t.id == 0xffff)
+		uint32 size = stream->readUint32LE();
+		if (!_strings.isShared())
+			_strings.reserve(_strings.size() + size);
+		setNameCount(_tileNames, _tileCount);
+
+		uint16 len = _isYoda ? 24 : 16;
+		while (!isAborted()) {
+			uint16 id = stream->readUint16LE();
+			if (id == 0xffff)
 				break;
 
-			uint16 len = _isYoda ? 24 : 16;
-			for (uint16 i = 0; i < len; i++)
-				t.name += _file->readByte();
-			t.name = t.name.c_str(); // Drop extra trailing nulls
-			debugC(1, kDebugResource, "entry id %04x (%d) is \"%s\"", t.id, t.id,
-			       t.name.c_str());
-			_tileNames.push_back(t);
+			setNameCount(_tileNames, id + 1);
+			_tileNames[id] = _strings.read(stream, len);
+			parseDebug(ctx, "entry id %04x (%d) is \"%s\"", id, id,
+			       _strings.get(_tileNames[id]));
 		}
 	}
 	break;
 	case MKTAG('Z', 'N', 'A', 'M'): { // Zone Names
-		_file->seek(sizeof(uint32), SEEK_CUR); // skip size;
-		while (!_vm->shouldQuit()) {
-			uint16 id = _file->readUint16LE();
+		uint32 size = stream->readUint32LE();
+		if (!_strings.isShared())
+			_strings.reserve(_strings.size() + size);
+		setNameCount(_zoneNames, _zoneCount);
+
+		uint16 len = _isYoda ? 24 : 16;
+		while (!isAborted()) {
+			uint16 id = stream->readUint16LE();
 			if (id == 0xffff)
 				break;
-			Common::String name;
-			uint16 len = _isYoda ? 24 : 16;
-			for (uint16 i = 0; i < len; i++)
-				name += _file->readByte();
-			name = name.c_str(); // Drop extra trailing nulls
-			debugC(1, kDebugResource, "entry id %04x (%d) is \"%s\"", id, id,
-			       name.c_str());
+
+			setNameCount(_zoneNames, id + 1);
+			_zoneNames[id] = _strings.read(stream, len);
+			parseDebug(ctx, "entry id %04x (%d) is \"%s\"", id, id,
+			       _strings.get(_zoneNames[id]));
 		}
 	}
 	break;
 	case MKTAG('C', 'H', 'A', 'R'): {
-		_file->seek(sizeof(uint32), SEEK_CUR); // skip size;
+		stream->seek(sizeof(uint32), SEEK_CUR); // skip size;
 		uint16 characterIndex = 0xFFFF;
 		uint32 lastTag = 0;
-		while (!_vm->shouldQuit() &&
-		        (characterIndex = _file->readUint16LE()) != 0xFFFF) {
-			debugC(1, kDebugResource, "    CHAR index: 0x%02x", characterIndex);
-			lastTag = this->readTag();
+		while (!isAborted() &&
+		        (characterIndex = stream->readUint16LE()) != 0xFFFF) {
+			parseDebug(ctx, "    CHAR index: 0x%02x", characterIndex);
+			lastTag = this->readTag(ctx);
 			assert(lastTag == MKTAG('I', 'C', 'H', 'A'));
 		}
 	}
 	break;
 	case MKTAG('I', 'C', 'H', 'A'): {
-		uint32 size = _file->readUint32LE();
+		uint32 size = stream->readUint32LE();
 
-		Common::String name;
-		byte character = 0;
-		while ((character = _file->readByte()) != 0)
-			name += character;
+		_characters.push_back(CHARACTER());
+		CHARACTER &ch = _characters.back();
+		ch.name = _strings.readString(stream);
+		uint32 nameSize = strlen(_strings.get(ch.name));
 
-		debugC(1, kDebugResource, "    CHAR name: \"%s\"", name.c_str());
-		const uint unknownDataSize = size - name.size() - 1 - 3 * 8 * 2;
-		uint8 *unknownData = new byte[unknownDataSize];
-		_file->read(unknownData, unknownDataSize);
-		delete[] unknownData;
+		parseDebug(ctx, "    CHAR name: \"%s\"", _strings.get(ch.name));
+		const uint typeDataSize = size - nameSize - 1 - 3 * 8 * 2;
+		ch.typeData = _characterData.size();
+		ch.typeDataSize = typeDataSize;
+		if (typeDataSize) {
+			_characterData.resize(ch.typeData + typeDataSize);
+			stream->read(&_characterData[ch.typeData], typeDataSize);
+		}
 
-		uint16 frames[3 * 8];
-		_file->read(frames, 3 * 8 * sizeof(uint16));
+		for (uint i = 0; i < 3; i++) {
+			for (uint j = 0; j < 8; j++)
+				ch.frames[i][j] = stream->readUint16LE();
+		}
 	}
 	break;
 	case MKTAG('A', 'C', 'T', 'N'): {
-		_file->seek(sizeof(uint32), SEEK_CUR); // skip size;
+		uint32 size = stream->readUint32LE();
+		if (!_strings.isShared())
+			_strings.reserve(_strings.size() + size);
 
 		uint16 zoneId = 0xFFFF;
-		while (!_vm->shouldQuit() && (zoneId = _file->readUint16LE()) != 0xFFFF) {
+		while (!isAborted() && (zoneId = stream->readUint16LE()) != 0xFFFF) {
 			uint32 lastTag = 0;
-			uint16 iactCount = _file->readUint16LE();
+			uint16 iactCount = stream->readUint16LE();
+			assert(zoneId < _zones.size());
+			ctx.zone = zoneId;
+			_zones[zoneId].firstAction = _actions.size();
+			_zones[zoneId].actionCount = iactCount;
 			for (uint16 j = 0; j < iactCount; j++) {
-				lastTag = this->readTag();
+				lastTag = this->readTag(ctx);
 				assert(lastTag == MKTAG('I', 'A', 'C', 'T'));
 			}
 		}
 	}
 	break;
 	case MKTAG('I', 'A', 'C', 'T'): {
-		uint32 ignored6 = _file->readUint32LE();
-		uint16 conditionCount = _file->readUint16LE();
-		debugC(1, kDebugResource, "  ACTN: condition %08x, count1 %d", ignored6,
-		       conditionCount);
-		for (uint16 k = 0; k < conditionCount; k++) {
-			SCRIPT *s = this->readScript();
-			debugC(1, kDebugResource,
+		uint32 ignored6 = stream->readUint32LE();
+		ACTION a;
+		a.zone = ctx.zone;
+		a.firstScript = _scripts.size();
+
+		// Conditions and instructions are stored back to back
+		a.conditionCount = stream->readUint16LE();
+		parseDebug(ctx, "  ACTN: condition %08x, count1 %d", ignored6,
+		       a.conditionCount);
+		for (uint16 k = 0; k < a.conditionCount; k++) {
+			_scripts.push_back(SCRIPT());
+			SCRIPT *s = &_scripts.back();
+			this->readScript(ctx, s);
+			parseDebug(ctx,
 			       "   ACTN condition %04x(%04x, %04x, %04x, %04x, %04x, %04x)",
-			       s->opcode, s->args[0], s->args[1], s->args[2], s->args[3], s->args[4], s->text != NULL ? (uint16)strlen(s->text) : -1);
+			       s->opcode, s->args[0], s->args[1], s->args[2], s->args[3], s->args[4], s->text != kNoString ? (uint16)strlen(_strings.get(s->text)) : -1);
 			assert(s->opcode < 0x26);
-			if (s->text) free(s->text);
-			delete s;
 		}
 
-		uint16 instructionCount = _file->readUint16LE();
-		debugC(1, kDebugResource, "  ACTN: instruction count %d", instructionCount);
-		for (uint16 k = 0; k < instructionCount; k++) {
-			SCRIPT *s = this->readScript();
-			debugC(1, kDebugResource,
+		a.instructionCount = stream->readUint16LE();
+		parseDebug(ctx, "  ACTN: instruction count %d", a.instructionCount);
+		for (uint16 k = 0; k < a.instructionCount; k++) {
+			_scripts.push_back(SCRIPT());
+			SCRIPT *s = &_scripts.back();
+			this->readScript(ctx, s);
+			parseDebug(ctx,
 			       "   ACTN instruction %04x(%04x, %04x, %04x, %04x, %04x, %04x)",
-			       s->opcode, s->args[0], s->args[1], s->args[2], s->args[3], s->args[4], s->text != NULL ? (uint16)strlen(s->text) : -1);
+			       s->opcode, s->args[0], s->args[1], s->args[2], s->args[3], s->args[4], s->text != kNoString ? (uint16)strlen(_strings.get(s->text)) : -1);
 			assert(s->opcode < 0x26);
-			if (s->text) free(s->text);
-			delete s;
 		}
+		_actions.push_back(a);
 	}
 	break;
 	case MKTAG('H', 'T', 'S', 'P'): {
-		_file->seek(sizeof(uint32), SEEK_CUR); // skip size;
+		stream->seek(sizeof(uint32), SEEK_CUR); // skip size;
 
 		uint16 zoneId = 0xFFFF;
-		while (!_vm->shouldQuit() && (zoneId = _file->readUint16LE()) != 0xFFFF) {
-			uint16 hotspotCount = _file->readUint16LE();
-			debugC(1, kDebugResource, "   %d Hotspots for zone: 0x%04x", hotspotCount,
+		while (!isAborted() && (zoneId = stream->readUint16LE()) != 0xFFFF) {
+			uint16 hotspotCount = stream->readUint16LE();
+			parseDebug(ctx, "   %d Hotspots for zone: 0x%04x", hotspotCount,
 			       zoneId);
-			for (uint i = 0; i < hotspotCount; i++) {
-				HOTSPOT *h = this->readHotspot();
-				debugC(1, kDebugResource, " zone hotspot data: type %08x, "
-				       "unknowns %04x, %04x, %04x, unknown data "
-				       "%04x",
-				       h->type, h->x, h->y, h->arg1, h->arg2);
-				delete h;
-			}
+			assert(zoneId < _zones.size());
+			// The cell grid is built by loadDone(), the zone may not be
+			// sized yet
+			_zones[zoneId].firstHotspot = _hotspots.size();
+			_zones[zoneId].hotspotCount = hotspotCount;
+			for (uint i = 0; i < hotspotCount; i++)
+				readHotspot(ctx);
 		}
 	}
 	break;
 	case MKTAG('P', 'U', 'Z', '2'): {
-		uint32 size = _file->readUint32LE();
-		debugC(1, kDebugResource, "Found %s tag, size %d", tag2str(tag), size);
-		while (!_vm->shouldQuit()) {
-			uint16 puzid = _file->readUint16LE();
+		uint32 size = stream->readUint32LE();
+		parseDebug(ctx, "Found %s tag, size %d", tag2str(tag), size);
+		if (!_strings.isShared())
+			_strings.reserve(_strings.size() + size);
+		while (!isAborted()) {
+			uint16 puzid = stream->readUint16LE();
 			if (puzid == 0xffff)
 				break;
-			tag = _file->readUint32BE();
+			tag = stream->readUint32BE();
 			assert(tag == MKTAG('I', 'P', 'U', 'Z'));
-			uint32 ipuzSize = _file->readUint32LE();
-			uint32 u1 = _file->readUint32LE();
-			uint32 u2 = _file->readUint32LE();
+			uint32 ipuzSize = stream->readUint32LE();
+			uint32 u1 = stream->readUint32LE();
+			uint32 u2 = stream->readUint32LE();
 			uint32 u3 = 0;
 			if (_isYoda)
-				u3 = _file->readUint32LE();
-			uint16 u4 = _file->readUint16LE();
-			debugC(1, kDebugResource,
+				u3 = stream->readUint32LE();
+			uint16 u4 = stream->readUint16LE();
+			parseDebug(ctx,
 			       "puz id %d (0x%04x) size %d, unknowns %08x, %08x, %08x, %04x",
 			       puzid, puzid, ipuzSize, u1, u2, u3, u4);
+			PUZZLE p;
+			p.id = puzid;
 			for (uint i = 0; i < 5; i++) {
-				uint16 strlen = _file->readUint16LE();
-				Common::String str;
-				for (uint16 j = 0; j < strlen; j++)
-					str += _file->readByte();
-				debugC(1, kDebugResource, " IPUZ string%d: \"%s\"", i, str.c_str());
+				uint16 strlen = stream->readUint16LE();
+				p.text[i] = _strings.read(stream, strlen);
+				parseDebug(ctx, " IPUZ string%d: \"%s\"", i, _strings.get(p.text[i]));
 			}
-			uint16 u5 = _file->readUint16LE();
+			_puzzles.push_back(p);
+			uint16 u5 = stream->readUint16LE();
 			uint16 u6 = 0;
 			if (_isYoda)
-				u6 = _file->readUint16LE();
-			debugC(1, kDebugResource, " IPUZ unknowns %04x, %04x", u5, u6);
+				u6 = stream->readUint16LE();
+			parseDebug(ctx, " IPUZ unknowns %04x, %04x", u5, u6);
 		}
 	}
 	break;
 	case MKTAG('T', 'I', 'L', 'E'): {
-		uint32 size = _file->readUint32LE();
-		_tileCount = size / 1028;
-		assert(_tileCount * 1028 == size);
-		debugC(1, kDebugResource, "Found %s tag, size %d, %d tiles", tag2str(tag),
+		uint32 size = stream->readUint32LE();
+		uint32 tileCount = size / 1028;
+		assert(tileCount * 1028 == size);
+		// Already known after an index or section scan, and possibly read
+		// by a concurrent TNAM job then
+		assert(_tileCount == 0 || _tileCount == tileCount);
+		if (_tileCount != tileCount)
+			_tileCount = tileCount;
+		parseDebug(ctx, "Found %s tag, size %d, %d tiles", tag2str(tag),
 		       size, _tileCount);
-		_tileDataOffset = _file->pos();
-		for (uint32 i = 0; i < _tileCount; i++) {
-			uint16 unknown1 = _file->readUint16LE();
-			uint16 unknown2 = _file->readUint16LE();
-			debugC(1, kDebugResource, "Tile #%d (%d, %d)", i, unknown1, unknown2);
-			_file->seek(32 * 32, SEEK_CUR);
-		}
-	}
-	break;
-	case MKTAG('Z', 'O', 'N', 'E'): {
-		if (!_isYoda) {
-			uint32 size = _file->readUint32LE();
-			debugC(1, kDebugResource, "size: %d", size);
-		}
-		_zoneCount = _file->readUint16LE();
-		debugC(1, kDebugResource, "ZONE tag: %d zones", _zoneCount);
-		for (uint16 i = 0; i < _zoneCount; i++) {
-			debugCN(1, kDebugResource, "\n");
-
-			// zone header
-			uint16 planet = 0;
-			if (_isYoda) {
-				planet = _file->readUint16LE();
-				uint32 size = _file->readUint32LE();
-				uint16 zone_id = _file->readUint16LE();
-				assert(zone_id == i);
-				debugC(1, kDebugResource,
-				       "zone entry #%04x (%d): unknowns %04x, size %d", zone_id,
-				       zone_id, planet, size);
-			}
+		_tileDataOffset = stream->pos();
 
-			uint32 lastTag = this->readTag();
-			assert(lastTag == MKTAG('I', 'Z', 'O', 'N'));
+		// A mapped file is shared with other processes, serve the pixels
+		// straight from it. Otherwise copy them into one contiguous, cache
+		// line aligned atlas.
+		byte *atlas = 0;
+		if (_map) {
+			_tileData = _data + _tileDataOffset + 4;
+			_tileStride = (32 * 32) + 4;
+		} else {
+			assert(_tileAtlasBuffer == 0);
+			_tileAtlasBuffer = new byte[(_tileCount * 32 * 32) + kTileAtlasAlignment - 1];
+			atlas = (byte *)(((size_t)_tileAtlasBuffer + kTileAtlasAlignment - 1) & ~(size_t)(kTileAtlasAlignment - 1));
+			_tileData = atlas;
+			_tileStride = 32 * 32;
 		}
+		_tileFlags.resize(_tileCount);
+		_tileCategories.resize(_tileCount);
+		for (uint32 i = 0; i < _tileCount; i++) {
+			uint16 lower = stream->readUint16LE();
+			uint16 upper = stream->readUint16LE();
+			parseDebug(ctx, "Tile #%d (%d, %d)", i, lower, upper);
+			_tileFlags[i] = lower | ((uint32)upper << 16);
+			_tileCategories[i] = classifyTile(lower);
+			if (atlas)
+				stream->read(atlas + (i * 32 * 32), 32 * 32);
+			else
+				stream->seek(32 * 32, SEEK_CUR);
+		}
+		analyzeTiles(ctx);
 	}
 	break;
+	case MKTAG('Z', 'O', 'N', 'E'):
+		beginZones(ctx);
+		while (_zoneWalk.next < _zoneCount && !isAborted())
+			walkZone(ctx);
+		endZones();
+		break;
 	case MKTAG('I', 'Z', 'O', 'N'): {
-		_file->seek(sizeof(uint32), SEEK_CUR); // skip size;
+		stream->seek(sizeof(uint32), SEEK_CUR); // skip size;
 
-		uint16 width = _file->readUint16LE();
-		uint16 height = _file->readUint16LE();
-		uint32 zoneType = _file->readUint32LE();
+		uint16 width = stream->readUint16LE();
+		uint16 height = stream->readUint16LE();
+		uint32 zoneType = stream->readUint32LE();
 		uint16 padding = 0;
 		uint16 planetAgain = 0;
 
@@ -402,132 +1163,394 @@ uint32 Resource::readTag(void) {
 		assert(width == 9 || width == 18);
 
 		if (_isYoda) {
-			padding = _file->readUint16LE(); // always 0xFFFF
-			planetAgain = _file->readUint16LE();
+			padding = stream->readUint16LE(); // always 0xFFFF
+			planetAgain = stream->readUint16LE();
 		}
-		debugC(1, kDebugResource, " %dx%d entries, unknowns %08x, %04x, %04x",
+		parseDebug(ctx, " %dx%d entries, unknowns %08x, %04x, %04x",
 		       width, height, zoneType, padding, planetAgain);
 
-		ZONE z;
+		// All three layers of a zone are stored back to back in the arena
+		ZONE &z = _zones[ctx.zone];
+		const uint cells = width * height;
 		z.width = width;
 		z.height = height;
-		z.tiles[0] = new uint16[width * height];
-		z.tiles[1] = new uint16[width * height];
-		z.tiles[2] = new uint16[width * height];
-
-		// tiles
-		for (uint16 j = 0; j < height; j++) {
-			for (uint16 k = 0; k < width; k++) {
-				uint16 u1 = _file->readUint16LE();
-				uint16 u2 = _file->readUint16LE();
-				uint16 u3 = _file->readUint16LE();
-				// debugC(1, kDebugResource, "(tile: %04x, %04x, %04x)", u1, u2,
-				// u3);
-				z.tiles[0][(j * width) + k] = u1;
-				z.tiles[1][(j * width) + k] = u2;
-				z.tiles[2][(j * width) + k] = u3;
-			}
-			debugCN(1, kDebugResource, "\n");
+		z.layerOffset = _zoneLayers.size();
+		_zoneLayers.resize(z.layerOffset + (3 * cells));
+		uint16 *layers = &_zoneLayers[z.layerOffset];
+
+		// tiles, three interleaved ids per cell. Every MemoryReadStream
+		// of a parse is over _data, decode from it in place.
+		const uint gridSize = cells * 3 * sizeof(uint16);
+		byte gridBuffer[18 * 18 * 3 * sizeof(uint16)];
+		const byte *grid = gridBuffer;
+		if (_data) {
+			grid = _data + stream->pos();
+			stream->seek(gridSize, SEEK_CUR);
+		} else {
+			stream->read(gridBuffer, gridSize);
 		}
-		_zones.push_back(z);
+		deinterleaveLayers(grid, layers, cells);
 
 		if (!_isYoda)
 			break;
 
-		uint16 hotspotCount = _file->readUint16LE();
-		debugC(1, kDebugResource, "zone hospot count %d", hotspotCount);
-		for (uint16 j = 0; j < hotspotCount; j++) {
-			HOTSPOT *h = this->readHotspot();
-			debugC(1, kDebugResource, " zone hotspot data: type %08x, "
-			       "unknowns %04x, %04x, %04x, unknown data "
-			       "%04x",
-			       h->type, h->x, h->y, h->arg1, h->arg2);
-			delete h;
-		}
+		uint16 hotspotCount = stream->readUint16LE();
+		parseDebug(ctx, "zone hospot count %d", hotspotCount);
+		z.firstHotspot = _hotspots.size();
+		z.hotspotCount = hotspotCount;
+		for (uint16 j = 0; j < hotspotCount; j++)
+			readHotspot(ctx);
+		if (hotspotCount)
+			buildHotspotGrid(z);
 
 		// read auxiliary data
 		uint32 lastTag;
-		lastTag = this->readTag();
+		lastTag = this->readTag(ctx);
 		assert(lastTag == MKTAG('I', 'Z', 'A', 'X'));
 
-		lastTag = this->readTag();
+		lastTag = this->readTag(ctx);
 		assert(lastTag == MKTAG('I', 'Z', 'X', '2'));
 
-		lastTag = this->readTag();
+		lastTag = this->readTag(ctx);
 		assert(lastTag == MKTAG('I', 'Z', 'X', '3'));
 
-		lastTag = this->readTag();
+		lastTag = this->readTag(ctx);
 		assert(lastTag == MKTAG('I', 'Z', 'X', '4'));
 
 		// read actions
-		uint16 iactCount = _file->readUint16LE();
-		debugC(1, kDebugResource, " IACT count: %d", iactCount);
+		uint16 iactCount = stream->readUint16LE();
+		parseDebug(ctx, " IACT count: %d", iactCount);
+		z.firstAction = _actions.size();
+		z.actionCount = iactCount;
 		for (uint16 j = 0; j < iactCount; j++) {
-			lastTag = this->readTag();
+			lastTag = this->readTag(ctx);
 			assert(lastTag == MKTAG('I', 'A', 'C', 'T'));
 		}
 	}
 	break;
 	default:
-		debugC(1, kDebugResource, "Unknown tag %s", tag2str(tag));
+		parseDebug(ctx, "Unknown tag %s", tag2str(tag));
 		assert(false);
 		break;
 	}
 	return tag;
 }
 
-SCRIPT *Resource::readScript() {
-	SCRIPT *s = new SCRIPT;
-	s->text = NULL;
-	s->opcode = _file->readUint16LE();
+void Resource::deinterleaveLayers(const byte *grid, uint16 *layers, uint cells) {
+	// READ_LE_UINT16 is a plain load on little endian hosts, which lets
+	// the compiler vectorize this
+	uint16 *layer1 = layers + cells;
+	uint16 *layer2 = layers + (2 * cells);
+	for (uint i = 0; i < cells; i++, grid += 3 * sizeof(uint16)) {
+		layers[i] = READ_LE_UINT16(grid);
+		layer1[i] = READ_LE_UINT16(grid + 2);
+		layer2[i] = READ_LE_UINT16(grid + 4);
+	}
+}
+
+void Resource::readScript(ParseContext &ctx, SCRIPT *s) {
+	Common::SeekableReadStream *stream = ctx.stream;
+	s->text = kNoString;
+	s->opcode = stream->readUint16LE();
 	for (int i = 0; i < 5; i++)
-		s->args[i] = _file->readUint16LE();
+		s->args[i] = stream->readUint16LE();
+
+	uint16 length = stream->readUint16LE();
+	if (length)
+		s->text = _strings.read(stream, length);
+}
+
+void Resource::readHotspot(ParseContext &ctx) {
+	Common::SeekableReadStream *stream = ctx.stream;
+	_hotspots.push_back(HOTSPOT());
+	_hotspotNext.push_back(kNoHotspot);
+	HOTSPOT *h = &_hotspots.back();
+	h->type = stream->readUint32LE();
+	h->x = stream->readUint16LE();
+	h->y = stream->readUint16LE();
+	h->enabled = stream->readUint16LE();
+	h->argument = stream->readUint16LE();
+	parseDebug(ctx, " zone hotspot data: type %08x, "
+	       "x %d, y %d, enabled %d, argument %04x",
+	       h->type, h->x, h->y, h->enabled, h->argument);
+}
+
+void Resource::buildHotspotGrid(ZONE &z) {
+	const uint cells = z.width * z.height;
+	// Reserved up front by the callers, so this does not reallocate
+	z.hotspotGrid = _hotspotGrids.size();
+	_hotspotGrids.resize(z.hotspotGrid + cells);
+	uint16 *grid = &_hotspotGrids[z.hotspotGrid];
+	for (uint i = 0; i < cells; i++)
+		grid[i] = kNoHotspot;
+
+	// Chain the hotspots of each cell, in file order
+	for (int i = z.hotspotCount - 1; i >= 0; i--) {
+		const HOTSPOT &h = _hotspots[z.firstHotspot + i];
+		if (h.x >= z.width || h.y >= z.height) {
+			_zoneWarnings.push_back(Common::String::format("zone %d hotspot %d at %d, %d is outside of its %dx%d zone",
+			                        (int)(&z - &_zones[0]), i, h.x, h.y, z.width, z.height));
+			continue;
+		}
+		uint16 &cell = grid[(h.y * z.width) + h.x];
+		_hotspotNext[z.firstHotspot + i] = cell;
+		cell = i;
+	}
+}
+
+void Resource::beginZones(ParseContext &ctx) {
+	Common::SeekableReadStream *stream = ctx.stream;
+	if (!_isYoda) {
+		uint32 size = stream->readUint32LE();
+		parseDebug(ctx, "size: %d", size);
+	}
+	uint16 zoneCount = stream->readUint16LE();
+	parseDebug(ctx, "ZONE tag: %d zones", zoneCount);
+	// A section scan already sized the table, concurrent ACTN and ZNAM
+	// jobs may be using it
+	assert(_zones.empty() || _zoneCount == zoneCount);
+	if (_zones.size() != zoneCount) {
+		_zoneCount = zoneCount;
+		resizeZones();
+	}
+
+	_zoneWalk.next = 0;
+	_zoneWalk.layerArenaSize = 0;
+	_zoneWalk.firstAction = 0;
+	_zoneWalk.firstScript = 0;
+	_zoneWalk.firstHotspot = 0;
+	if (_isYoda) {
+		// Indy's tables are filled by ACTN and HTSP jobs running
+		// alongside, only endZones() for Yoda needs these
+		_zoneWalk.firstAction = _actions.size();
+		_zoneWalk.firstScript = _scripts.size();
+		_zoneWalk.firstHotspot = _hotspots.size();
+	}
+	_zoneWalk.start = stream->pos();
+	// Size the arenas before decoding into them, growing them zone by
+	// zone would move them every time. A section scan already added the
+	// zones up, else walkZone() skips over all of them first.
+	_zoneWalk.sizing = !(_flags & kResourceLazyZones) && !_zoneLayerTotal && _zoneCount;
+	if (!(_flags & kResourceLazyZones) && !_zoneWalk.sizing) {
+		_zoneLayers.reserve(_zoneLayers.size() + _zoneLayerTotal);
+		_hotspotGrids.reserve(_hotspotGrids.size() + (_zoneLayerTotal / 3));
+	}
+	_zoneWalk.sizes = ParseContext(stream);
+	_zoneWalk.sizes.log = ctx.log;
+}
+
+void Resource::walkZone(ParseContext &ctx) {
+	Common::SeekableReadStream *stream = ctx.stream;
+	if (_zoneWalk.sizing) {
+		sizeZone(ctx);
+		return;
+	}
+
+	uint16 i = _zoneWalk.next++;
+	// zone header
+	uint16 planet = 0;
+	if (_isYoda) {
+		planet = stream->readUint16LE();
+		uint32 size = stream->readUint32LE();
+		uint16 zone_id = stream->readUint16LE();
+		assert(zone_id == i);
+		parseDebug(ctx,
+		       "zone entry #%04x (%d): unknowns %04x, size %d", zone_id,
+		       zone_id, planet, size);
+	}
+
+	ZONE *z = &_zones[i];
+	z->offset = stream->pos();
+	z->layerOffset = kZoneNotDecoded;
+	if (_flags & kResourceLazyZones) {
+		// Only note where the zone is, getZone() decodes it
+		_zoneWalk.sizes.stream = stream;
+		skipZone(_zoneWalk.sizes, z);
+		_zoneWalk.layerArenaSize += z->width * z->height * 3;
+		return;
+	}
+
+	ctx.zone = i;
+	uint32 lastTag = this->readTag(ctx);
+	assert(lastTag == MKTAG('I', 'Z', 'O', 'N'));
+}
 
-	uint16 length = _file->readUint16LE();
-	if (length) {
-		s->text = (char *)malloc(length);
-		_file->read(s->text, length);
+void Resource::sizeZone(ParseContext &ctx) {
+	Common::SeekableReadStream *stream = ctx.stream;
+	_zoneWalk.next++;
+	if (_isYoda)
+		stream->seek(2 + 4 + 2, SEEK_CUR); // planet, size, id
+	ZONE z;
+	_zoneWalk.sizes.stream = stream;
+	skipZone(_zoneWalk.sizes, &z);
+	_zoneLayerTotal += z.width * z.height * 3;
+	if (_zoneWalk.next < _zoneCount)
+		return;
+
+	_zoneLayers.reserve(_zoneLayers.size() + _zoneLayerTotal);
+	_hotspotGrids.reserve(_hotspotGrids.size() + (_zoneLayerTotal / 3));
+	// Without a section scan nothing reserved the pool for the action
+	// texts yet
+	_strings.reserve(_strings.size() + _zoneWalk.sizes.textSize);
+
+	// Then decode from the first zone again
+	stream->seek(_zoneWalk.start, SEEK_SET);
+	_zoneWalk.next = 0;
+	_zoneWalk.sizing = false;
+	_zoneWalk.sizes = ParseContext(stream);
+	_zoneWalk.sizes.log = ctx.log;
+}
+
+void Resource::endZones(void) {
+	if (_flags & kResourceLazyZones) {
+		// Lazily decoded zones then never move the arena, the other
+		// tables are reserved once loading is done
+		_zoneLayers.reserve(_zoneWalk.layerArenaSize);
+		_hotspotGrids.reserve(_zoneWalk.layerArenaSize / 3);
+		_zoneActionTotal = _zoneWalk.sizes.actionCount;
+		_zoneScriptTotal = _zoneWalk.sizes.scriptCount;
+		_zoneTextTotal = _zoneWalk.sizes.textSize;
+		_zoneHotspotTotal = _zoneWalk.sizes.hotspotCount;
+	} else if (_isYoda) {
+		// Only Yoda zones carry actions and hotspots, Indy's come from
+		// concurrent ACTN and HTSP jobs
+		_zoneActionTotal = _actions.size() - _zoneWalk.firstAction;
+		_zoneHotspotTotal = _hotspots.size() - _zoneWalk.firstHotspot;
+		_zoneScriptTotal = _scripts.size() - _zoneWalk.firstScript;
+		_zoneTextTotal = 0;
+		for (uint32 i = _zoneWalk.firstScript; i < _scripts.size(); i++) {
+			if (_scripts[i].text != kNoString)
+				_zoneTextTotal += strlen(_strings.get(_scripts[i].text)) + 1;
+		}
 	}
+}
+
+void Resource::skipZone(ParseContext &ctx, ZONE *z) {
+	Common::SeekableReadStream *stream = ctx.stream;
+	uint32 tag = stream->readUint32BE();
+	assert(tag == MKTAG('I', 'Z', 'O', 'N'));
+	stream->seek(sizeof(uint32), SEEK_CUR); // skip size;
+
+	z->width = stream->readUint16LE();
+	z->height = stream->readUint16LE();
+	assert(z->height == 9 || z->height == 18);
+	assert(z->width == 9 || z->width == 18);
+
+	// zone type, Yoda padding and planet, tiles
+	stream->seek(sizeof(uint32) + (_isYoda ? 4 : 0) + (z->width * z->height * 3 * 2), SEEK_CUR);
+	if (!_isYoda)
+		return;
+
+	uint16 hotspotCount = stream->readUint16LE();
+	stream->seek(hotspotCount * 12, SEEK_CUR);
+	ctx.hotspotCount += hotspotCount;
 
-	return s;
+	// auxiliary data is only skipped by readTag()
+	for (uint i = 0; i < 4; i++)
+		this->readTag(ctx);
+
+	uint16 iactCount = stream->readUint16LE();
+	ctx.actionCount += iactCount;
+	for (uint16 j = 0; j < iactCount; j++) {
+		tag = stream->readUint32BE();
+		assert(tag == MKTAG('I', 'A', 'C', 'T'));
+		stream->seek(sizeof(uint32), SEEK_CUR);
+		// conditions, then instructions
+		for (uint k = 0; k < 2; k++) {
+			uint16 count = stream->readUint16LE();
+			ctx.scriptCount += count;
+			for (uint16 l = 0; l < count; l++) {
+				stream->seek(6 * 2, SEEK_CUR); // opcode and arguments
+				uint16 length = stream->readUint16LE();
+				stream->seek(length, SEEK_CUR);
+				if (length)
+					ctx.textSize += length + 1;
+			}
+		}
+	}
 }
 
-HOTSPOT *Resource::readHotspot() {
-	HOTSPOT *h = new HOTSPOT;
-	h->type = _file->readUint32LE();
-	h->arg1 = _file->readUint16LE();
-	h->arg2 = _file->readUint16LE();
-	h->x = _file->readUint16LE();
-	h->y = _file->readUint16LE();
-	return h;
+void Resource::resizeZones(void) {
+	_zones.resize(_zoneCount);
+	for (uint i = 0; i < _zoneCount; i++) {
+		_zones[i].firstHotspot = 0;
+		_zones[i].hotspotCount = 0;
+		_zones[i].hotspotGrid = kNoHotspotGrid;
+		_zones[i].offset = 0;
+		_zones[i].layerOffset = kZoneNotDecoded;
+		_zones[i].width = 0;
+		_zones[i].height = 0;
+		_zones[i].firstAction = 0;
+		_zones[i].actionCount = 0;
+	}
 }
 
-ZONE *Resource::getZone(uint num) {
+const ZONE *Resource::getZone(uint num) {
 	if (num >= _zones.size()) {
 		warning("Resource::getZone(%d) ref is out of range", num);
 		return 0;
 	}
 
-	return &_zones[num];
+	// Any engine sharing this may be decoding a zone
+	Common::StackLock lock(_accessMutex);
+	ZONE *z = &_zones[num];
+	if (z->layerOffset == kZoneNotDecoded) {
+		debugC(1, kDebugResource, "Decoding zone %d", num);
+		ParseContext ctx(_stream);
+		ctx.zone = num;
+		_stream->seek(z->offset, SEEK_SET);
+		uint32 tag = this->readTag(ctx);
+		assert(tag == MKTAG('I', 'Z', 'O', 'N'));
+		reportWarnings();
+	}
+
+	return z;
 }
 
-byte *Resource::getStupData(void) {
-	byte *data = new byte[32 * 32 * 9 * 9];
-	_file->seek(_stupOffset, SEEK_SET);
-	_file->read(data, 32 * 32 * 9 * 9);
-	return data;
+const ACTION *Resource::getZoneActions(uint num, uint16 &count) {
+	count = 0;
+	const ZONE *z = getZone(num);
+	if (!z || !z->actionCount)
+		return 0;
+
+	count = z->actionCount;
+	return &_actions[z->firstAction];
 }
 
-byte *Resource::getTileData(uint32 ref) {
+const HOTSPOT *Resource::getZoneHotspots(uint num, uint16 &count) {
+	count = 0;
+	const ZONE *z = getZone(num);
+	if (!z || !z->hotspotCount)
+		return 0;
+
+	count = z->hotspotCount;
+	return &_hotspots[z->firstHotspot];
+}
+
+const HOTSPOT *Resource::getHotspotAt(const ZONE *z, uint x, uint y) {
+	if (z->hotspotGrid == kNoHotspotGrid || x >= z->width || y >= z->height)
+		return 0;
+
+	uint16 i = _hotspotGrids[z->hotspotGrid + (y * z->width) + x];
+	return i == kNoHotspot ? 0 : &_hotspots[z->firstHotspot + i];
+}
+
+const HOTSPOT *Resource::getNextHotspotAt(const ZONE *z, const HOTSPOT *h) {
+	uint16 i = _hotspotNext[h - &_hotspots[0]];
+	return i == kNoHotspot ? 0 : &_hotspots[z->firstHotspot + i];
+}
+
+const byte *Resource::getStupData(void) {
+	return _stupData;
+}
+
+const byte *Resource::getTileData(uint32 ref) {
 	if (ref >= _tileCount) {
 		warning("Resource::getTileData(%d) ref is out of range", ref);
 		return 0;
 	}
 
-	byte *data = new byte[32 * 32];
-	_file->seek(_tileDataOffset + (ref * ((32 * 32) + 4)) + 4, SEEK_SET);
-	_file->read(data, 32 * 32);
-	return data;
+	return _tileData + (ref * _tileStride);
 }
 
 uint16 Resource::getTileFlags(uint32 ref, bool upperField) {
@@ -536,9 +1559,95 @@ uint16 Resource::getTileFlags(uint32 ref, bool upperField) {
 		return 0;
 	}
 
-	_file->seek(_tileDataOffset + (ref * ((32 * 32) + 4)) + (upperField ? 2 : 0),
-	            SEEK_SET);
-	return _file->readUint16LE();
+	return upperField ? (_tileFlags[ref] >> 16) : (_tileFlags[ref] & 0xFFFF);
+}
+
+const TILEINFO *Resource::getTileInfo(uint32 ref) {
+	if (ref >= _tileInfo.size()) {
+		warning("Resource::getTileInfo(%d) ref is out of range", ref);
+		return 0;
+	}
+	return &_tileInfo[ref];
+}
+
+void Resource::analyzeTiles(ParseContext &ctx) {
+	_tileInfo.resize(_tileCount);
+	for (uint32 i = 0; i < _tileCount && !isAborted(); i++) {
+		const byte *tile = _tileData + (i * _tileStride);
+		TILEINFO &info = _tileInfo[i];
+		info.left = info.top = 32;
+		info.right = info.bottom = 0;
+		info.spanCount = 0;
+		info.firstSpan = _tileSpans.size();
+
+		uint opaque = 0;
+		bool systemColor = false;
+		for (uint y = 0; y < 32; y++) {
+			const byte *row = tile + (y * 32);
+			uint x = 0;
+			while (x < 32) {
+				while (x < 32 && row[x] == TRANSPARENT)
+					x++;
+				if (x == 32)
+					break;
+
+				TILESPAN span;
+				span.x = x;
+				span.y = y;
+				while (x < 32 && row[x] != TRANSPARENT) {
+					byte pixel = row[x];
+					if (!systemColor && ((pixel < 10) || (pixel != 255 && pixel > 245))) {
+						_tileWarnings.push_back(Common::String::format("tile %d uses System Palette Index: %d", i, pixel));
+						systemColor = true;
+					}
+					x++;
+				}
+				span.width = x - span.x;
+				opaque += span.width;
+				_tileSpans.push_back(span);
+
+				info.left = MIN<byte>(info.left, span.x);
+				info.right = MAX<byte>(info.right, x);
+				info.top = MIN<byte>(info.top, y);
+				info.bottom = y + 1;
+			}
+		}
+
+		info.spanCount = _tileSpans.size() - info.firstSpan;
+		if (opaque == 32 * 32 || opaque == 0) {
+			// Nothing to keep, drawn whole or not at all
+			info.shape = opaque ? kTileShapeOpaque : kTileShapeEmpty;
+			_tileSpans.resize(info.firstSpan);
+			info.spanCount = 0;
+			if (!opaque)
+				info.left = info.top = 0;
+		} else {
+			info.shape = kTileShapeMasked;
+		}
+	}
+	parseDebug(ctx, "%d tile spans", _tileSpans.size());
+}
+
+TileCategory Resource::classifyTile(uint16 lowerFlags) {
+	// A tile carries at most one of these in practice, check the most
+	// specific ones first.
+	if (lowerFlags & TILE_LOWER_CHARACTER)
+		return kTileCategoryCharacter;
+	if (lowerFlags & TILE_LOWER_ITEM)
+		return kTileCategoryItem;
+	if (lowerFlags & TILE_LOWER_WEAPON)
+		return kTileCategoryWeapon;
+	if (lowerFlags & TILE_LOWER_LOCATOR)
+		return kTileCategoryLocator;
+	if (lowerFlags & TILE_LOWER_ROOF)
+		return kTileCategoryRoof;
+	if (lowerFlags & TILE_LOWER_DRAGGABLE)
+		return kTileCategoryDraggable;
+	if (lowerFlags & TILE_LOWER_OBJECT)
+		return kTileCategoryObject;
+	if (lowerFlags & TILE_LOWER_FLOOR)
+		return kTileCategoryFloor;
+	return kTileCategoryNone;
 }
 
 const char *Resource::getTileName(uint32 ref) {
@@ -547,21 +1656,90 @@ const char *Resource::getTileName(uint32 ref) {
 		return 0;
 	}
 
-	for (uint32 i = 0; i < _tileNames.size(); i++) {
-		if (ref == _tileNames[i].id)
-			return _tileNames[i].name.c_str();
+	if (ref >= _tileNames.size())
+		return 0; // Tile name not found.
+	return _strings.get(_tileNames[ref]);
+}
+
+const char *Resource::getZoneName(uint16 num) {
+	if (num >= _zoneNames.size())
+		return 0;
+	return _strings.get(_zoneNames[num]);
+}
+
+const char *Resource::getActionName(uint16 zone, uint16 action) {
+	for (uint i = 0; i < _actionNames.size(); i++) {
+		if (_actionNames[i].zone == zone && _actionNames[i].action == action)
+			return _strings.get(_actionNames[i].name);
 	}
-	// Tile name not found.
 	return 0;
 }
 
+const char *Resource::getPuzzleName(uint16 num) {
+	if (num >= _puzzleNames.size())
+		return 0;
+	return _strings.get(_puzzleNames[num]);
+}
+
+const char *Resource::getPuzzleText(uint16 num, uint i) {
+	if (num >= _puzzles.size() || i >= 5) {
+		warning("Resource::getPuzzleText(%d, %d) ref is out of range", num, i);
+		return 0;
+	}
+	return _strings.get(_puzzles[num].text[i]);
+}
+
+void Resource::resolveCharacterFrames(void) {
+	_characterFrames.resize(_characters.size() * 3 * 8);
+	for (uint i = 0; i < _characters.size(); i++) {
+		const uint16 *frames = &_characters[i].frames[0][0];
+		for (uint j = 0; j < 3 * 8; j++) {
+			if (frames[j] < _tileCount)
+				_characterFrames[i * 3 * 8 + j] = _tileData + (frames[j] * _tileStride);
+			else
+				_characterFrames[i * 3 * 8 + j] = 0;
+		}
+	}
+}
+
+const CHARACTER *Resource::getCharacter(uint16 num) {
+	if (num >= _characters.size()) {
+		warning("Resource::getCharacter(%d) ref is out of range", num);
+		return 0;
+	}
+	return &_characters[num];
+}
+
+const char *Resource::getCharacterName(uint16 num) {
+	if (num >= _characters.size())
+		return 0;
+	return _strings.get(_characters[num].name);
+}
+
+const byte *Resource::getCharacterFrame(uint16 num, uint set, uint frame) {
+	if (num >= _characters.size() || set >= 3 || frame >= 8) {
+		warning("Resource::getCharacterFrame(%d, %d, %d) ref is out of range", num, set, frame);
+		return 0;
+	}
+	return _characterFrames[(num * 3 + set) * 8 + frame];
+}
+
 const char *Resource::getSoundFilename(uint16 ref) {
 	if (ref >= _soundFiles.size()) {
 		warning("Resource::getSoundFilename(%d) ref is out of range", ref);
 		return 0;
 	}
 
-	return _soundFiles[ref].c_str();
+	return _strings.get(_soundFiles[ref]);
+}
+
+void Resource::setNameCount(Common::Array<StringRef> &names, uint32 count) {
+	uint32 oldSize = names.size();
+	if (count <= oldSize)
+		return;
+	names.resize(count);
+	for (uint32 i = oldSize; i < count; i++)
+		names[i] = kNoString;
 }
 
 } // End of namespace Deskadv
@@ -28,58 +28,251 @@
 
 #include "common/file.h"
 
-namespace Deskadv {
+#include "deskadv/stringpool.h"
+#include "deskadv/workerpool.h"
 
-class DeskadvEngine;
+namespace Deskadv {
 
-typedef struct tname {
-	uint16 id;
-	Common::String name;
-} TNAME;
+class MappedFile;
 
 typedef struct zone {
+	uint32 offset;      // of the IZON tag in the resource file
+	uint32 layerOffset; // into the zone layer arena
 	uint16 width;
 	uint16 height;
-	uint16 *tiles[3];
+	uint32 firstAction;
+	uint16 actionCount;
+	uint16 hotspotCount;
+	uint32 firstHotspot;
+	uint32 hotspotGrid; // width * height cells into the hotspot grid arena
 } ZONE;
 
+static const uint32 kZoneNotDecoded = 0xFFFFFFFF;
+static const uint32 kNoHotspotGrid = 0xFFFFFFFF;
+static const uint16 kNoHotspot = 0xFFFF;
+
+// Empty cell of a zone layer
+static const uint16 kNoTile = 0xFFFF;
+
 typedef struct script {
 	uint16 opcode;
 	uint16 args[5];
-	char *text;
+	StringRef text;
 } SCRIPT;
 
+typedef struct action {
+	uint16 zone;
+	uint16 conditionCount;
+	uint16 instructionCount;
+	uint32 firstScript; // conditions, then instructions
+} ACTION;
+
+typedef struct actionname {
+	uint16 zone;
+	uint16 action;
+	StringRef name;
+} ACTIONNAME;
+
+typedef struct puzzle {
+	uint16 id;
+	StringRef text[5];
+} PUZZLE;
+
+typedef struct section {
+	uint32 tag;
+	uint32 offset; // of the tag in the resource file
+} SECTION;
+
+typedef struct character {
+	StringRef name;
+	uint32 typeData;     // into the character type data arena
+	uint16 typeDataSize;
+	uint16 frames[3][8]; // tile ids, kNoTile if unused
+} CHARACTER;
+
 typedef struct hotspot {
 	uint32 type;
 	uint16 x;
 	uint16 y;
-	uint16 arg1;
-	uint16 arg2;
+	uint16 enabled;
+	uint16 argument;
 } HOTSPOT;
 
+// Where the resource file is parsed from
+enum ResourceBackend {
+	kResourceBackendFile = 0,   // Read each field from Common::File
+	kResourceBackendMemory = 1, // Read the whole file once, parse from memory
+	kResourceBackendMmap = 2    // Map the file read-only (POSIX only)
+};
+
+// Resource::load() flags
+enum {
+	kResourceLazyZones = (1 << 0), // Decode zones on first getZone()
+	kResourceUseIndex = (1 << 1),  // Load/save a section index sidecar
+	kResourceThreaded = (1 << 2)   // Parse sections on worker threads
+};
+
 // Tile Flag Masks
 #define TILE_LOWER_USE_TRANSPARENCY 0x0001
+#define TILE_LOWER_FLOOR            0x0002
+#define TILE_LOWER_OBJECT           0x0004
+#define TILE_LOWER_DRAGGABLE        0x0008
+#define TILE_LOWER_ROOF             0x0010
+#define TILE_LOWER_LOCATOR          0x0020
+#define TILE_LOWER_WEAPON           0x0040
+#define TILE_LOWER_ITEM             0x0080
+#define TILE_LOWER_CHARACTER        0x0100
+
+// Upper field meaning depends on the category
+#define TILE_UPPER_FLOOR_DOORWAY    0x0001
+
+#define TILE_UPPER_ITEM_KEYCARD     0x0001
+#define TILE_UPPER_ITEM_TOOL        0x0002
+#define TILE_UPPER_ITEM_PART        0x0004
+#define TILE_UPPER_ITEM_VALUABLE    0x0008
+#define TILE_UPPER_ITEM_LOCATOR     0x0010
+#define TILE_UPPER_ITEM_EDIBLE      0x0040
+
+#define TILE_UPPER_WEAPON_LIGHT_BLASTER 0x0001
+#define TILE_UPPER_WEAPON_HEAVY_BLASTER 0x0002
+#define TILE_UPPER_WEAPON_LIGHTSABER    0x0004
+#define TILE_UPPER_WEAPON_THE_FORCE     0x0008
+
+#define TILE_UPPER_CHARACTER_HERO   0x0001
+#define TILE_UPPER_CHARACTER_ENEMY  0x0002
+#define TILE_UPPER_CHARACTER_NPC    0x0004
+
+enum TileCategory {
+	kTileCategoryNone = 0,
+	kTileCategoryFloor,
+	kTileCategoryObject,
+	kTileCategoryDraggable,
+	kTileCategoryRoof,
+	kTileCategoryLocator,
+	kTileCategoryWeapon,
+	kTileCategoryItem,
+	kTileCategoryCharacter
+};
+
+// Pixels of a tile against the transparent color
+enum TileShape {
+	kTileShapeEmpty = 0, // Fully transparent
+	kTileShapeOpaque,    // No transparent pixel
+	kTileShapeMasked
+};
+
+// Opaque run of a tile row
+typedef struct tilespan {
+	byte x;
+	byte y;
+	byte width;
+} TILESPAN;
+
+typedef struct tileinfo {
+	byte shape;
+	// Bounding box of the opaque pixels, right and bottom exclusive
+	byte left;
+	byte top;
+	byte right;
+	byte bottom;
+	uint16 spanCount;
+	uint32 firstSpan; // Masked tiles only, row by row
+} TILEINFO;
+
+// Alignment of the tile atlas, in bytes. Each 32x32 tile is a whole
+// number of cache lines, so every tile starts on a line boundary.
+static const uint kTileAtlasAlignment = 64;
 
 class Resource {
 public:
-	Resource(DeskadvEngine *vm);
+	// md5 is the detection MD5 of the file, it names the index sidecar
+	Resource(const char *md5);
 	virtual ~Resource(void);
 
-	bool load(const char *filename, bool isYoda);
+	bool load(const char *filename, bool isYoda, ResourceBackend backend = kResourceBackendMemory, uint32 flags = 0);
 
-	byte *getStupData(void);
+	// Incremental loading: open() decodes just enough for the STUP splash
+	// screen, loadNext() then makes progress for up to budget ms per call
+	// and returns true once everything is loaded. Nothing but
+	// getStupData() may be used before that.
+	bool open(const char *filename, bool isYoda, ResourceBackend backend = kResourceBackendMemory, uint32 flags = 0);
+	bool loadNext(uint32 budget);
+	void finishLoad(void);
+	uint getLoadProgress(void); // percent
+
+	const byte *getStupData(void);
 
 	uint32 getTileCount(void) {
 		return _tileCount;
 	}
-	byte *getTileData(uint32 ref);
+	// Returns a pointer to the tile's 32x32 pixels (row pitch 32), either
+	// in the resident tile atlas or in the mapped file. Valid for the
+	// lifetime of the Resource.
+	const byte *getTileData(uint32 ref);
 	uint16 getTileFlags(uint32 ref, bool upperField);
+	TileCategory getTileCategory(uint32 ref) {
+		return ref < _tileCount ? (TileCategory)_tileCategories[ref] : kTileCategoryNone;
+	}
+	bool isTileTransparent(uint32 ref) {
+		return ref < _tileCount && (_tileFlags[ref] & TILE_LOWER_USE_TRANSPARENCY);
+	}
 	const char *getTileName(uint32 ref);
+	// Shape of the tile from a pass over the atlas at load
+	const TILEINFO *getTileInfo(uint32 ref);
+	const TILESPAN *getTileSpans(const TILEINFO *t) {
+		return t->spanCount ? &_tileSpans[t->firstSpan] : 0;
+	}
 
 	uint16 getZoneCount(void) {
 		return _zoneCount;
 	}
-	ZONE *getZone(uint num);
+	const ZONE *getZone(uint num);
+	// width * height tile ids of one layer of a zone from getZone(). The
+	// three layers of a zone are contiguous.
+	const uint16 *getZoneLayer(const ZONE *z, uint layer) {
+		return &_zoneLayers[z->layerOffset + (layer * z->width * z->height)];
+	}
+	const char *getZoneName(uint16 num);
+
+	// Actions of a zone, decoding the zone first if needed. Pointers into
+	// the action and script tables stay valid for the lifetime of the
+	// Resource.
+	const ACTION *getZoneActions(uint num, uint16 &count);
+	const SCRIPT *getConditions(const ACTION *a) {
+		return &_scripts[a->firstScript];
+	}
+	const SCRIPT *getInstructions(const ACTION *a) {
+		return &_scripts[a->firstScript + a->conditionCount];
+	}
+	const char *getScriptText(const SCRIPT *s) {
+		return _strings.get(s->text);
+	}
+	const char *getActionName(uint16 zone, uint16 action);
+
+	// Hotspots of a zone, decoding the zone first if needed
+	const HOTSPOT *getZoneHotspots(uint num, uint16 &count);
+	// First hotspot on a cell of a zone from getZone(), 0 if there is
+	// none. getNextHotspotAt() walks the others on the same cell.
+	const HOTSPOT *getHotspotAt(const ZONE *z, uint x, uint y);
+	const HOTSPOT *getNextHotspotAt(const ZONE *z, const HOTSPOT *h);
+
+	uint16 getPuzzleCount(void) {
+		return _puzzles.size();
+	}
+	const char *getPuzzleName(uint16 num);
+	const char *getPuzzleText(uint16 num, uint i);
+
+	uint16 getCharacterCount(void) {
+		return _characters.size();
+	}
+	const CHARACTER *getCharacter(uint16 num);
+	const char *getCharacterName(uint16 num);
+	const byte *getCharacterTypeData(const CHARACTER *c) {
+		return c->typeDataSize ? &_characterData[c->typeData] : 0;
+	}
+	// 32x32 pixels of an animation frame, resolved once loading is done.
+	// 0 for an unused frame.
+	const byte *getCharacterFrame(uint16 num, uint set, uint frame);
 
 	uint16 getSoundCount(void) {
 		return _soundFiles.size();
@@ -87,25 +280,186 @@ public:
 	const char *getSoundFilename(uint16 ref);
 
 private:
-	DeskadvEngine *_vm;
+	Common::String _md5;
+	Common::String _filename;
 
-	Common::File *_file;
+	// Serializes loading and lazy zone decoding between engines sharing
+	// this Resource
+	Common::Mutex _accessMutex;
+	// Set when the Resource goes away mid load, parse loops stop early.
+	// Polled by the workers, only accessed under _abortMutex.
+	bool _abort;
+	Common::Mutex _abortMutex;
+	bool isAborted(void);
+
+	Common::SeekableReadStream *_stream;
 	bool _isYoda;
+	uint32 _flags;
+
+	// Top level sections in file order
+	Common::Array<SECTION> _sections;
+
+	// Whole resource file, only with kResourceBackendMemory (owned buffer)
+	// or kResourceBackendMmap (mapping)
+	const byte *_data;
+	byte *_dataBuffer;
+	MappedFile *_map;
+	uint32 _dataSize;
 
 	uint32 _stupOffset;
+	const byte *_stupData;
+	byte *_stupBuffer;
 
 	uint32 _tileCount;
 	uint32 _tileDataOffset;
-	Common::Array<TNAME> _tileNames;
+	const byte *_tileData;
+	uint32 _tileStride;
+	byte *_tileAtlasBuffer;
+	Common::Array<uint32> _tileFlags; // lower field | (upper field << 16)
+	Common::Array<byte> _tileCategories;
+	Common::Array<StringRef> _tileNames; // indexed by tile id
+	Common::Array<TILEINFO> _tileInfo;
+	Common::Array<TILESPAN> _tileSpans;
+
+	// Problems found while parsing, possibly on a worker thread where
+	// warning() is not safe. One array per writing job, reported from the
+	// loading thread by reportWarnings().
+	Common::Array<Common::String> _tileWarnings; // TILE
+	Common::Array<Common::String> _zoneWarnings; // ZONE, hotspot grids
 
 	uint16 _zoneCount;
 	Common::Array<ZONE> _zones;
+	Common::Array<uint16> _zoneLayers;
+	// Cells of all three layers over all zones, 0 until known
+	uint32 _zoneLayerTotal;
+	Common::Array<StringRef> _zoneNames;
+	Common::Array<ACTIONNAME> _actionNames;
+
+	Common::Array<ACTION> _actions;
+	Common::Array<SCRIPT> _scripts;
+	// Totals over all IZON action lists, reserved for lazy decoding
+	uint32 _zoneActionTotal;
+	uint32 _zoneScriptTotal;
+	uint32 _zoneTextTotal;
+	uint32 _zoneHotspotTotal;
+
+	Common::Array<HOTSPOT> _hotspots;
+	// Next hotspot on the same cell, per hotspot and relative to the
+	// zone's first one
+	Common::Array<uint16> _hotspotNext;
+	// Per zone cell grids of the first hotspot on each cell
+	Common::Array<uint16> _hotspotGrids;
+
+	Common::Array<StringRef> _puzzleNames;
+	Common::Array<PUZZLE> _puzzles;
+
+	Common::Array<CHARACTER> _characters;
+	Common::Array<byte> _characterData;
+	// Tile pixels per character animation frame, 3 * 8 per character
+	Common::Array<const byte *> _characterFrames;
+
+	Common::Array<StringRef> _soundFiles;
+
+	// All names and texts from the resource file
+	StringPool _strings;
+
+	enum LoadState {
+		kLoadIdle,
+		kLoadWalk,     // Serial parse, one top level section per step
+		kLoadSections, // Sections handed to _workers
+		kLoadDone
+	};
+	LoadState _loadState;
+	bool _indexed;
+
+	// Diagnostics of a worker, printed by the main thread
+	struct LogLine {
+		bool warning;
+		Common::String text;
+	};
+
+	// One sequential parse through the file, workers each have their own
+	struct ParseContext {
+		Common::SeekableReadStream *stream;
+		uint16 zone; // Zone the IZON and IACT handlers decode into
+		Common::Array<LogLine> *log; // Held back output, 0 to print directly
+
+		// Counted by skipZone()
+		uint32 actionCount;
+		uint32 scriptCount;
+		uint32 textSize;
+		uint32 hotspotCount;
+
+		ParseContext(Common::SeekableReadStream *s) : stream(s), zone(0), log(0),
+			actionCount(0), scriptCount(0), textSize(0), hotspotCount(0) {}
+	};
+
+	// Progress through the ZONE section, kept across the steps of the
+	// serial walk
+	struct ZoneWalk {
+		bool active; // Serial walk is inside ZONE
+		bool sizing; // Adding the zones up before decoding them
+		int32 start; // First zone entry
+		uint16 next;
+		uint32 layerArenaSize;
+		uint32 firstAction;
+		uint32 firstScript;
+		uint32 firstHotspot;
+		ParseContext sizes; // Counted by skipZone() while sizing or for lazy zones
+
+		ZoneWalk() : sizes(0) {}
+	};
+	ZoneWalk _zoneWalk;
+
+	struct SectionJob {
+		Resource *resource;
+		uint section;
+		uint32 size;
+		Common::Array<LogLine> log;
+	};
+
+	Common::Array<SectionJob> _jobs;
+	Common::Array<void *> _jobArgs;
+	WorkerPool _workers;
+	Common::Mutex _stringMutex;
+
+	void walkSection(void);
+	bool scanSections(void);
+	static bool isIndexedSection(uint32 tag);
+	void startSections(void);
+	void finishSections(void);
+	void loadDone(void);
+	void reportWarnings(void);
+	static void parseSectionProc(void *arg);
+	void parseSection(Common::SeekableReadStream *stream, uint section, Common::Array<LogLine> *log);
+	void parseDebug(ParseContext &ctx, const char *s, ...) GCC_PRINTF(3, 4);
+	void parseWarning(ParseContext &ctx, const char *s, ...) GCC_PRINTF(3, 4);
 
-	Common::Array<Common::String> _soundFiles;
+	uint32 readTag(ParseContext &ctx);
+	void skipZone(ParseContext &ctx, ZONE *z);
+	void beginZones(ParseContext &ctx);
+	void walkZone(ParseContext &ctx);
+	void sizeZone(ParseContext &ctx);
+	void endZones(void);
+	void resizeZones(void);
 
-	uint32 readTag(void);
-	SCRIPT *readScript();
-	HOTSPOT *readHotspot();
+	Common::String getIndexFilename(void);
+	bool loadIndex(void);
+	bool readIndex(Common::SeekableReadStream *in);
+	void saveIndex(void);
+	void writeIndexString(Common::WriteStream *out, StringRef ref);
+	bool readIndexString(Common::SeekableReadStream *in, StringRef &ref);
+	void writeIndexNames(Common::WriteStream *out, const Common::Array<StringRef> &names);
+	bool readIndexNames(Common::SeekableReadStream *in, Common::Array<StringRef> &names);
+	bool readIndexCount(Common::SeekableReadStream *in, uint32 entrySize, uint32 &count);
+	static TileCategory classifyTile(uint16 lowerFlags);
+	void analyzeTiles(ParseContext &ctx);
+	static void setNameCount(Common::Array<StringRef> &names, uint32 count);
+	static void deinterleaveLayers(const byte *grid, uint16 *layers, uint cells);
+	void readScript(ParseContext &ctx, SCRIPT *s);
+	void readHotspot(ParseContext &ctx);
+	void buildHotspotGrid(ZONE &z);
+	void resolveCharacterFrames(void);
 };
 
 } // End of namespace Deskadv
@@ -0,0 +1,89 @@
+/* ScummVM - Graphic Adventure Engine
+ *
+ * ScummVM is the legal property of its developers, whose names
+ * are too numerous to list here. Please refer to the COPYRIGHT
+ * file distributed with this source distribution.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * $URL$
+ * $Id$
+ *
+ */
+
+#include "deskadv/deskadv.h"
+#include "deskadv/resourcecache.h"
+
+DECLARE_SINGLETON(Deskadv::ResourceCache);
+
+namespace Deskadv {
+
+ResourceCache::ResourceCache() {
+}
+
+ResourceCache::~ResourceCache() {
+	for (uint i = 0; i < _entries.size(); i++) {
+		warning("ResourceCache: \"%s\" still has %d users", _entries[i].key.c_str(), _entries[i].refCount);
+		delete _entries[i].resource;
+	}
+}
+
+Resource *ResourceCache::acquire(const char *filename, const char *md5, bool isYoda, ResourceBackend backend, uint32 flags) {
+	Common::StackLock lock(_mutex);
+
+	// Engines asking for another backend or other flags get their own
+	// Resource, sharing would silently ignore what they asked for
+	Common::String key = Common::String::format("%s:%s:%d:%d:%x", filename, md5, isYoda ? 1 : 0, (int)backend, flags);
+	for (uint i = 0; i < _entries.size(); i++) {
+		if (_entries[i].key == key) {
+			_entries[i].refCount++;
+			debugC(1, kDebugResource, "Sharing \"%s\", %d users", key.c_str(), _entries[i].refCount);
+			return _entries[i].resource;
+		}
+	}
+
+	Resource *resource = new Resource(md5);
+	if (!resource->open(filename, isYoda, backend, flags)) {
+		delete resource;
+		return 0;
+	}
+
+	Entry entry;
+	entry.key = key;
+	entry.resource = resource;
+	entry.refCount = 1;
+	_entries.push_back(entry);
+	return resource;
+}
+
+void ResourceCache::release(Resource *resource) {
+	Common::StackLock lock(_mutex);
+
+	for (uint i = 0; i < _entries.size(); i++) {
+		if (_entries[i].resource != resource)
+			continue;
+
+		if (--_entries[i].refCount == 0) {
+			debugC(1, kDebugResource, "Dropping \"%s\"", _entries[i].key.c_str());
+			delete resource;
+			_entries.remove_at(i);
+		}
+		return;
+	}
+
+	warning("ResourceCache::release() unknown resource");
+}
+
+} // End of namespace Deskadv
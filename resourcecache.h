@@ -0,0 +1,68 @@
+/* ScummVM - Graphic Adventure Engine
+ *
+ * ScummVM is the legal property of its developers, whose names
+ * are too numerous to list here. Please refer to the COPYRIGHT
+ * file distributed with this source distribution.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * $URL$
+ * $Id$
+ *
+ */
+
+#ifndef DESKADV_RESOURCECACHE_H
+#define DESKADV_RESOURCECACHE_H
+
+#include "common/array.h"
+#include "common/mutex.h"
+#include "common/singleton.h"
+#include "common/str.h"
+
+#include "deskadv/resource.h"
+
+namespace Deskadv {
+
+// Parsed resource files shared by every engine instance in the process,
+// keyed by file name and detection MD5. A Resource is immutable once
+// loaded, per session state lives with the engine.
+class ResourceCache : public Common::Singleton<ResourceCache> {
+public:
+	// Returns the Resource for the file, opening it on first use with the
+	// given backend and flags. Later users get it as it was opened and,
+	// like the first one, finish loading it with loadNext(). Every
+	// Resource returned needs a matching release().
+	Resource *acquire(const char *filename, const char *md5, bool isYoda, ResourceBackend backend, uint32 flags);
+	// Deletes the Resource once its last user is gone
+	void release(Resource *resource);
+
+private:
+	friend class Common::Singleton<SingletonBaseType>;
+	ResourceCache();
+	~ResourceCache();
+
+	struct Entry {
+		Common::String key;
+		Resource *resource;
+		uint refCount;
+	};
+
+	Common::Array<Entry> _entries;
+	Common::Mutex _mutex;
+};
+
+} // End of namespace Deskadv
+
+#endif
@@ -0,0 +1,144 @@
+/* ScummVM - Graphic Adventure Engine
+ *
+ * ScummVM is the legal property of its developers, whose names
+ * are too numerous to list here. Please refer to the COPYRIGHT
+ * file distributed with this source distribution.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * $URL$
+ * $Id$
+ *
+ */
+
+#include "common/util.h"
+
+#include "deskadv/stringpool.h"
+
+namespace Deskadv {
+
+// Holds the pool's mutex, if there is one, for the current scope
+class PoolLock {
+public:
+	PoolLock(Common::Mutex *mutex) : _mutex(mutex) {
+		if (_mutex)
+			_mutex->lock();
+	}
+	~PoolLock() {
+		if (_mutex)
+			_mutex->unlock();
+	}
+
+private:
+	Common::Mutex *_mutex;
+};
+
+StringPool::StringPool() {
+	_count = 0;
+	_reserved = 0;
+	_mutex = 0;
+	rehash(256);
+}
+
+StringPool::~StringPool() {
+}
+
+void StringPool::reserve(uint32 size) {
+	PoolLock lock(_mutex);
+	_reserved = MAX(_reserved, size);
+	_data.reserve(size);
+}
+
+StringRef StringPool::read(Common::ReadStream *stream, uint32 len) {
+	// Decode straight into the pool, intern() rolls it back if it is a
+	// duplicate.
+	PoolLock lock(_mutex);
+	uint32 start = _data.size();
+	// resize() allocates exactly, grow geometrically outside of reserved
+	// sections
+	if (start + len + 1 > _reserved) {
+		_reserved = MAX(start + len + 1, _reserved * 2);
+		_data.reserve(_reserved);
+	}
+	_data.resize(start + len + 1);
+	uint32 got = stream->read(&_data[start], len);
+	_data[start + got] = 0;
+	_data.resize(start + strlen(&_data[start]) + 1);
+	return intern(start);
+}
+
+StringRef StringPool::readString(Common::ReadStream *stream) {
+	PoolLock lock(_mutex);
+	uint32 start = _data.size();
+	char c;
+	while ((c = stream->readByte()) != 0)
+		_data.push_back(c);
+	_data.push_back(0);
+	return intern(start);
+}
+
+StringRef StringPool::add(const char *str, uint32 len) {
+	PoolLock lock(_mutex);
+	uint32 start = _data.size();
+	for (uint32 i = 0; i < len && str[i] != 0; i++)
+		_data.push_back(str[i]);
+	_data.push_back(0);
+	return intern(start);
+}
+
+StringRef StringPool::intern(uint32 start) {
+	const char *str = &_data[start];
+	uint32 mask = _buckets.size() - 1;
+	uint32 i = hash(str) & mask;
+	while (_buckets[i] != kNoString) {
+		if (!strcmp(&_data[_buckets[i]], str)) {
+			_data.resize(start);
+			return _buckets[i];
+		}
+		i = (i + 1) & mask;
+	}
+
+	_buckets[i] = start;
+	if (++_count * 2 > _buckets.size())
+		rehash(_buckets.size() * 2);
+	return start;
+}
+
+void StringPool::rehash(uint32 bucketCount) {
+	Common::Array<StringRef> old = _buckets;
+	_buckets.resize(bucketCount);
+	for (uint32 i = 0; i < bucketCount; i++)
+		_buckets[i] = kNoString;
+
+	uint32 mask = bucketCount - 1;
+	for (uint32 j = 0; j < old.size(); j++) {
+		if (old[j] == kNoString)
+			continue;
+		uint32 i = hash(&_data[old[j]]) & mask;
+		while (_buckets[i] != kNoString)
+			i = (i + 1) & mask;
+		_buckets[i] = old[j];
+	}
+}
+
+uint32 StringPool::hash(const char *str) {
+	// FNV-1a
+	uint32 h = 2166136261u;
+	while (*str)
+		h = (h ^ (byte)*str++) * 16777619u;
+	return h;
+}
+
+} // End of namespace Deskadv
@@ -0,0 +1,88 @@
+/* ScummVM - Graphic Adventure Engine
+ *
+ * ScummVM is the legal property of its developers, whose names
+ * are too numerous to list here. Please refer to the COPYRIGHT
+ * file distributed with this source distribution.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * $URL$
+ * $Id$
+ *
+ */
+
+#ifndef DESKADV_STRINGPOOL_H
+#define DESKADV_STRINGPOOL_H
+
+#include "common/array.h"
+#include "common/mutex.h"
+#include "common/stream.h"
+
+namespace Deskadv {
+
+// Handle to a string in a StringPool
+typedef uint32 StringRef;
+static const StringRef kNoString = 0xFFFFFFFF;
+
+// Interned, NUL terminated strings packed into one growable buffer.
+// Handles stay valid as the pool grows, pointers returned by get() only
+// until the next add.
+class StringPool {
+public:
+	StringPool();
+	~StringPool();
+
+	void reserve(uint32 size);
+
+	// Serializes reserve(), read(), readString() and add() on mutex while
+	// set. get() is only safe alongside them if the pool was reserved
+	// large enough not to move.
+	void setMutex(Common::Mutex *mutex) {
+		_mutex = mutex;
+	}
+	bool isShared() const {
+		return _mutex != 0;
+	}
+
+	// Reads a len byte field and interns it up to its first NUL
+	StringRef read(Common::ReadStream *stream, uint32 len);
+	// Reads and interns a NUL terminated string
+	StringRef readString(Common::ReadStream *stream);
+	StringRef add(const char *str, uint32 len);
+
+	const char *get(StringRef ref) const {
+		return ref == kNoString ? 0 : &_data[ref];
+	}
+	uint32 size() const {
+		return _data.size();
+	}
+
+private:
+	Common::Array<char> _data;
+
+	// Open addressing hash table of StringRefs, size is a power of two
+	Common::Array<StringRef> _buckets;
+	uint32 _count;
+	uint32 _reserved; // At least the capacity of _data
+	Common::Mutex *_mutex;
+
+	StringRef intern(uint32 start);
+	void rehash(uint32 bucketCount);
+	static uint32 hash(const char *str);
+};
+
+} // End of namespace Deskadv
+
+#endif
@@ -0,0 +1,194 @@
+/* ScummVM - Graphic Adventure Engine
+ *
+ * ScummVM is the legal property of its developers, whose names
+ * are too numerous to list here. Please refer to the COPYRIGHT
+ * file distributed with this source distribution.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * $URL$
+ * $Id$
+ *
+ */
+
+// pthreads are not covered by the OSystem API
+#define FORBIDDEN_SYMBOL_ALLOW_ALL
+
+#include "common/util.h"
+
+#include "deskadv/deskadv.h"
+#include "deskadv/workerpool.h"
+
+#if defined(POSIX)
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+namespace Deskadv {
+
+struct WorkQueue {
+#if defined(POSIX)
+	pthread_mutex_t mutex;
+	pthread_t *threads;
+#endif
+	bool threaded; // false when the calls are made by poll()
+	uint threadCount;
+
+	WorkerProc proc;
+	void **args;
+	uint count;
+	uint next;
+	uint finished;
+
+	void lock() {
+#if defined(POSIX)
+		if (threaded)
+			pthread_mutex_lock(&mutex);
+#endif
+	}
+	void unlock() {
+#if defined(POSIX)
+		if (threaded)
+			pthread_mutex_unlock(&mutex);
+#endif
+	}
+};
+
+static void *workerMain(void *arg) {
+	WorkQueue *queue = (WorkQueue *)arg;
+	while (true) {
+		queue->lock();
+		uint i = queue->next;
+		if (i < queue->count)
+			queue->next++;
+		queue->unlock();
+		if (i >= queue->count)
+			break;
+
+		queue->proc(queue->args[i]);
+
+		queue->lock();
+		queue->finished++;
+		queue->unlock();
+	}
+	return 0;
+}
+
+WorkerPool::WorkerPool() {
+	_queue = 0;
+}
+
+WorkerPool::~WorkerPool() {
+	stop();
+}
+
+bool WorkerPool::isSupported() {
+#if defined(POSIX)
+	return true;
+#else
+	return false;
+#endif
+}
+
+void WorkerPool::start(WorkerProc proc, void **args, uint count, bool threaded) {
+	assert(_queue == 0);
+
+	_queue = new WorkQueue();
+	_queue->threaded = false;
+	_queue->threadCount = 0;
+	_queue->proc = proc;
+	_queue->args = args;
+	_queue->count = count;
+	_queue->next = 0;
+	_queue->finished = 0;
+
+#if defined(POSIX)
+	long cpus = threaded ? sysconf(_SC_NPROCESSORS_ONLN) : 0;
+	uint threadCount = (cpus > 0) ? MIN<uint>(cpus, count) : 0;
+	if (threadCount) {
+		pthread_mutex_init(&_queue->mutex, 0);
+		_queue->threads = new pthread_t[threadCount];
+		_queue->threaded = true;
+		while (_queue->threadCount < threadCount &&
+		        pthread_create(&_queue->threads[_queue->threadCount], 0, workerMain, _queue) == 0)
+			_queue->threadCount++;
+		if (!_queue->threadCount) {
+			delete[] _queue->threads;
+			pthread_mutex_destroy(&_queue->mutex);
+			_queue->threaded = false;
+		}
+		debugC(1, kDebugResource, "Running %d jobs on %d threads", count, _queue->threadCount);
+	}
+#endif
+}
+
+bool WorkerPool::poll() {
+	if (!_queue)
+		return true;
+
+	if (!_queue->threaded && _queue->next < _queue->count) {
+		uint i = _queue->next++;
+		_queue->proc(_queue->args[i]);
+		_queue->finished++;
+	}
+
+	return getFinished() == _queue->count;
+}
+
+void WorkerPool::wait() {
+	if (!_queue)
+		return;
+
+#if defined(POSIX)
+	if (_queue->threaded) {
+		for (uint i = 0; i < _queue->threadCount; i++)
+			pthread_join(_queue->threads[i], 0);
+		delete[] _queue->threads;
+		pthread_mutex_destroy(&_queue->mutex);
+		_queue->threaded = false;
+	}
+#endif
+	// Whatever is left when there are no threads
+	workerMain(_queue);
+
+	delete _queue;
+	_queue = 0;
+}
+
+void WorkerPool::stop() {
+	if (!_queue)
+		return;
+
+	_queue->lock();
+	_queue->count = _queue->next;
+	_queue->unlock();
+	wait();
+}
+
+uint WorkerPool::getCount() const {
+	return _queue ? _queue->count : 0;
+}
+
+uint WorkerPool::getFinished() const {
+	if (!_queue)
+		return 0;
+
+	_queue->lock();
+	uint finished = _queue->finished;
+	_queue->unlock();
+	return finished;
+}
+
+} // End of namespace Deskadv
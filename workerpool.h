@@ -0,0 +1,66 @@
+/* ScummVM - Graphic Adventure Engine
+ *
+ * ScummVM is the legal property of its developers, whose names
+ * are too numerous to list here. Please refer to the COPYRIGHT
+ * file distributed with this source distribution.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * $URL$
+ * $Id$
+ *
+ */
+
+#ifndef DESKADV_WORKERPOOL_H
+#define DESKADV_WORKERPOOL_H
+
+#include "common/scummsys.h"
+
+namespace Deskadv {
+
+typedef void (*WorkerProc)(void *arg);
+
+struct WorkQueue;
+
+// Calls a function once for every argument of a batch. With threads the
+// calls run in the background on one thread per online CPU. Otherwise,
+// or where threads are not implemented (anything but POSIX), poll()
+// makes them one at a time on the calling thread.
+class WorkerPool {
+public:
+	WorkerPool();
+	~WorkerPool();
+
+	static bool isSupported();
+
+	void start(WorkerProc proc, void **args, uint count, bool threaded);
+	// Returns true once every call has finished. Without threads it makes
+	// the next call first.
+	bool poll();
+	// Blocks until every call has finished
+	void wait();
+	// Drops the calls that have not started yet and waits for the rest
+	void stop();
+
+	uint getCount() const;
+	uint getFinished() const;
+
+private:
+	WorkQueue *_queue;
+};
+
+} // End of namespace Deskadv
+
+#endif
@@ -0,0 +1,285 @@
+/* ScummVM - Graphic Adventure Engine
+ *
+ * ScummVM is the legal property of its developers, whose names
+ * are too numerous to list here. Please refer to the COPYRIGHT
+ * file distributed with this source distribution.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * $URL$
+ * $Id$
+ *
+ */
+
+#include "deskadv/deskadv.h"
+#include "deskadv/zonestate.h"
+
+namespace Deskadv {
+
+ZoneState::ZoneState(Resource *resource) : _resource(resource) {
+	_revision = 0;
+}
+
+ZoneState::~ZoneState() {
+}
+
+bool ZoneState::checkCell(const char *func, uint zone, uint x, uint y, uint layer, const ZONE *&z) {
+	z = _resource->getZone(zone);
+	if (!z)
+		return false;
+
+	if (x >= z->width || y >= z->height || layer > 2) {
+		warning("ZoneState::%s(%d) x:%d y:%d layer:%d out of range", func, zone, x, y, layer);
+		return false;
+	}
+	return true;
+}
+
+const uint16 *ZoneState::getLayer(uint zone, uint layer) {
+	const ZONE *z = _resource->getZone(zone);
+	if (!z || layer > 2)
+		return 0;
+
+	if (!isDirty(zone))
+		return _resource->getZoneLayer(z, layer);
+	return &_layers[_copies[zone] + (layer * z->width * z->height)];
+}
+
+uint16 ZoneState::getTile(uint zone, uint x, uint y, uint layer) {
+	const ZONE *z;
+	if (!checkCell("getTile", zone, x, y, layer, z))
+		return kNoTile;
+
+	return getLayer(zone, layer)[(y * z->width) + x];
+}
+
+void ZoneState::setTile(uint zone, uint x, uint y, uint layer, uint16 tile) {
+	const ZONE *z;
+	if (!checkCell("setTile", zone, x, y, layer, z))
+		return;
+
+	uint16 *layers = copyZone(zone);
+	layers[(layer * z->width * z->height) + (y * z->width) + x] = tile;
+	_revision++;
+
+	if (layer != kZoneLayerRoof && zone < _bitboardIndex.size() && _bitboardIndex[zone] != kNoBitboards)
+		updateCell(_bitboards[_bitboardIndex[zone]], z, zone, (y * z->width) + x);
+}
+
+void ZoneState::moveTile(uint zone, uint x, uint y, uint layer, uint toX, uint toY) {
+	// Both cells are checked before anything is written, a bad move must
+	// neither lose the tile nor copy the zone
+	const ZONE *z;
+	if (!checkCell("moveTile", zone, x, y, layer, z) ||
+	        !checkCell("moveTile", zone, toX, toY, layer, z))
+		return;
+	if (x == toX && y == toY)
+		return;
+
+	uint16 tile = getTile(zone, x, y, layer);
+	setTile(zone, x, y, layer, kNoTile);
+	setTile(zone, toX, toY, layer, tile);
+}
+
+uint16 *ZoneState::copyZone(uint zone) {
+	const ZONE *z = _resource->getZone(zone);
+	if (!isDirty(zone)) {
+		debugC(1, kDebugResource, "Copying zone %d on first write", zone);
+		if (_copies.size() < _resource->getZoneCount()) {
+			uint oldSize = _copies.size();
+			_copies.resize(_resource->getZoneCount());
+			for (uint i = oldSize; i < _copies.size(); i++)
+				_copies[i] = kPristine;
+		}
+
+		const uint cells = z->width * z->height;
+		_copies[zone] = _layers.size();
+		_dirtyZones.push_back(zone);
+		_layers.resize(_copies[zone] + (3 * cells));
+		// The three pristine layers are contiguous as well
+		memcpy(&_layers[_copies[zone]], _resource->getZoneLayer(z, 0), 3 * cells * sizeof(uint16));
+	}
+	return &_layers[_copies[zone]];
+}
+
+void ZoneState::reset() {
+	_copies.clear();
+	_dirtyZones.clear();
+	_layers.clear();
+	_bitboardIndex.clear();
+	_bitboards.clear();
+	_revision++;
+}
+
+void ZoneState::updateCell(ZoneBitboards &b, const ZONE *z, uint zone, uint cell) {
+	const uint cells = z->width * z->height;
+	const uint16 *layers = isDirty(zone) ? &_layers[_copies[zone]] : _resource->getZoneLayer(z, 0);
+	uint16 floor = layers[cell];
+	uint16 object = layers[cells + cell];
+
+	bool walkable = floor != kNoTile && (_resource->getTileFlags(floor, false) & TILE_LOWER_FLOOR);
+	bool blocking = false;
+	if (object != kNoTile) {
+		switch (_resource->getTileCategory(object)) {
+		case kTileCategoryObject:
+		case kTileCategoryDraggable:
+		case kTileCategoryCharacter:
+			blocking = true;
+			break;
+		default:
+			break;
+		}
+	}
+
+	const uint32 bit = 1 << (cell & 31);
+	const uint word = cell >> 5;
+	b.walkable[word] = walkable ? (b.walkable[word] | bit) : (b.walkable[word] & ~bit);
+	b.blocking[word] = blocking ? (b.blocking[word] | bit) : (b.blocking[word] & ~bit);
+	b.objects[word] = (object != kNoTile) ? (b.objects[word] | bit) : (b.objects[word] & ~bit);
+}
+
+const ZoneBitboards *ZoneState::getBitboards(uint zone) {
+	if (zone < _bitboardIndex.size() && _bitboardIndex[zone] != kNoBitboards)
+		return &_bitboards[_bitboardIndex[zone]];
+
+	const ZONE *z = _resource->getZone(zone);
+	if (!z)
+		return 0;
+
+	if (_bitboardIndex.size() < _resource->getZoneCount()) {
+		uint oldSize = _bitboardIndex.size();
+		_bitboardIndex.resize(_resource->getZoneCount());
+		for (uint i = oldSize; i < _bitboardIndex.size(); i++)
+			_bitboardIndex[i] = kNoBitboards;
+	}
+
+	debugC(1, kDebugCollision, "Building bitboards for zone %d", zone);
+	_bitboardIndex[zone] = _bitboards.size();
+	_bitboards.push_back(ZoneBitboards());
+	ZoneBitboards &b = _bitboards.back();
+	memset(&b, 0, sizeof(b));
+	for (uint cell = 0; cell < (uint)(z->width * z->height); cell++)
+		updateCell(b, z, zone, cell);
+	return &b;
+}
+
+bool ZoneState::isCellFree(uint zone, uint x, uint y) {
+	const ZONE *z = _resource->getZone(zone);
+	if (!z || x >= z->width || y >= z->height)
+		return false;
+
+	const ZoneBitboards *b = getBitboards(zone);
+	const uint cell = (y * z->width) + x;
+	return testCell(b->walkable, cell) && !testCell(b->blocking, cell);
+}
+
+uint ZoneState::trace(uint zone, uint x, uint y, int dx, int dy) {
+	const ZONE *z = _resource->getZone(zone);
+	if (!z || x >= z->width || y >= z->height || (!dx && !dy))
+		return 0;
+
+	const ZoneBitboards *b = getBitboards(zone);
+	const int step = (dy * z->width) + dx;
+	int cell = (y * z->width) + x;
+	const uint fromX = x, fromY = y;
+	uint free = 0;
+	while (true) {
+		x += dx;
+		y += dy;
+		cell += step;
+		// Unsigned wrap around covers stepping off the top or left
+		if (x >= z->width || y >= z->height)
+			break;
+		if (!testCell(b->walkable, cell) || testCell(b->blocking, cell))
+			break;
+		free++;
+	}
+	debugC(1, kDebugCollision, "trace(%d) from %d, %d by %d, %d: %d free", zone, fromX, fromY, dx, dy, free);
+	return free;
+}
+
+/* zone state deltas
+ *
+ * [4] changed cell count
+ *     [2] zone id
+ *     [1] x
+ *     [1] y
+ *     [1] layer
+ *     [2] tile id
+ */
+
+uint32 ZoneState::writeDeltas(Common::WriteStream *out) {
+	uint32 count = 0;
+	for (uint i = 0; i < _dirtyZones.size(); i++) {
+		uint16 zone = _dirtyZones[i];
+		const ZONE *z = _resource->getZone(zone);
+		const uint cells = z->width * z->height;
+		const uint16 *pristine = _resource->getZoneLayer(z, 0);
+		const uint16 *layers = &_layers[_copies[zone]];
+		for (uint j = 0; j < 3 * cells; j++) {
+			if (layers[j] == pristine[j])
+				continue;
+			count++;
+			if (!out)
+				continue;
+			out->writeUint16LE(zone);
+			out->writeByte((j % cells) % z->width);
+			out->writeByte((j % cells) / z->width);
+			out->writeByte(j / cells);
+			out->writeUint16LE(layers[j]);
+		}
+	}
+	return count;
+}
+
+void ZoneState::saveDeltas(Common::WriteStream *out) {
+	// Counted first, the stream can not go back to fill it in
+	out->writeUint32LE(writeDeltas(0));
+	writeDeltas(out);
+}
+
+bool ZoneState::loadDeltas(Common::SeekableReadStream *in) {
+	reset();
+
+	uint32 count = in->readUint32LE();
+	if (count > (uint32)(in->size() - in->pos()) / 7) {
+		warning("ZoneState::loadDeltas() is truncated");
+		return false;
+	}
+	for (uint32 i = 0; i < count; i++) {
+		uint16 zone = in->readUint16LE();
+		uint x = in->readByte();
+		uint y = in->readByte();
+		uint layer = in->readByte();
+		uint16 tile = in->readUint16LE();
+		const ZONE *z;
+		if (!checkCell("loadDeltas", zone, x, y, layer, z)) {
+			if (!z)
+				warning("ZoneState::loadDeltas() zone %d does not match the resource file", zone);
+			reset();
+			return false;
+		}
+		setTile(zone, x, y, layer, tile);
+	}
+
+	if (in->err() || in->eos()) {
+		warning("ZoneState::loadDeltas() is truncated");
+		reset();
+		return false;
+	}
+	return true;
+}
+
+} // End of namespace Deskadv
@@ -0,0 +1,146 @@
+/* ScummVM - Graphic Adventure Engine
+ *
+ * ScummVM is the legal property of its developers, whose names
+ * are too numerous to list here. Please refer to the COPYRIGHT
+ * file distributed with this source distribution.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * $URL$
+ * $Id$
+ *
+ */
+
+#ifndef DESKADV_ZONESTATE_H
+#define DESKADV_ZONESTATE_H
+
+#include "common/array.h"
+#include "common/stream.h"
+
+#include "deskadv/resource.h"
+
+namespace Deskadv {
+
+// Zone layers, as used by the tile instructions
+enum {
+	kZoneLayerFloor = 0,
+	kZoneLayerObject = 1,
+	kZoneLayerRoof = 2
+};
+
+// One bit per cell of a zone, bit (y * width + x) % 32 of word
+// (y * width + x) / 32
+static const uint kBitboardWords = (18 * 18 + 31) / 32;
+
+struct ZoneBitboards {
+	uint32 walkable[kBitboardWords]; // floor that may be stepped on
+	uint32 blocking[kBitboardWords]; // objects, draggables, characters
+	uint32 objects[kBitboardWords];  // anything on the object layer
+};
+
+static inline bool testCell(const uint32 *bitboard, uint cell) {
+	return (bitboard[cell >> 5] >> (cell & 31)) & 1;
+}
+
+// Per session view of the zones of a shared Resource. Reads go to the
+// pristine layers until a zone is first written, only then its three
+// layers are copied into the session (copy on write).
+class ZoneState {
+public:
+	ZoneState(Resource *resource);
+	~ZoneState();
+
+	Resource *getResource() {
+		return _resource;
+	}
+
+	// width * height tile ids, like Resource::getZoneLayer(). Valid until
+	// the next write to a pristine zone.
+	const uint16 *getLayer(uint zone, uint layer);
+	uint16 getTile(uint zone, uint x, uint y, uint layer);
+	void setTile(uint zone, uint x, uint y, uint layer, uint16 tile);
+
+	// Tile instructions
+	void placeTile(uint zone, uint x, uint y, uint layer, uint16 tile) {
+		setTile(zone, x, y, layer, tile);
+	}
+	void removeTile(uint zone, uint x, uint y, uint layer) {
+		setTile(zone, x, y, layer, kNoTile);
+	}
+	void moveTile(uint zone, uint x, uint y, uint layer, uint toX, uint toY);
+	void dropItem(uint zone, uint x, uint y, uint16 item) {
+		setTile(zone, x, y, kZoneLayerObject, item);
+	}
+
+	// Collision bitboards of a zone, built from its layers and the tile
+	// flags on first use and kept up to date by setTile(). Valid until
+	// the bitboards of another zone are first built.
+	const ZoneBitboards *getBitboards(uint zone);
+	// A free cell is walkable and not blocked
+	bool isCellFree(uint zone, uint x, uint y);
+	// Free cells from (x, y), excluded, stepping by (dx, dy) up to the
+	// first blocked cell or the edge of the zone
+	uint trace(uint zone, uint x, uint y, int dx, int dy);
+	// Incremented on every tile change, for caches built on the layers
+	uint32 getRevision() const {
+		return _revision;
+	}
+
+	// Zones written to, in order of their first write
+	uint getDirtyZoneCount() const {
+		return _dirtyZones.size();
+	}
+	uint16 getDirtyZone(uint i) const {
+		return _dirtyZones[i];
+	}
+	bool isDirty(uint zone) const {
+		return zone < _copies.size() && _copies[zone] != kPristine;
+	}
+
+	// Drops every change
+	void reset();
+
+	// Only the cells that differ from the resource file are written
+	void saveDeltas(Common::WriteStream *out);
+	bool loadDeltas(Common::SeekableReadStream *in);
+
+private:
+	static const uint32 kPristine = 0xFFFFFFFF;
+	static const uint32 kNoBitboards = 0xFFFFFFFF;
+
+	Resource *_resource;
+
+	// Offset of every zone's copy in _layers, kPristine while unchanged
+	Common::Array<uint32> _copies;
+	Common::Array<uint16> _dirtyZones;
+	// Copied zones, three layers each, back to back
+	Common::Array<uint16> _layers;
+
+	// Index of every zone's bitboards, kNoBitboards until first used
+	Common::Array<uint32> _bitboardIndex;
+	Common::Array<ZoneBitboards> _bitboards;
+	uint32 _revision;
+
+	void updateCell(ZoneBitboards &b, const ZONE *z, uint zone, uint cell);
+
+	uint16 *copyZone(uint zone);
+	// Writes the changed cells if out is set, returns their count
+	uint32 writeDeltas(Common::WriteStream *out);
+	bool checkCell(const char *func, uint zone, uint x, uint y, uint layer, const ZONE *&z);
+};
+
+} // End of namespace Deskadv
+
+#endif